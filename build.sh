@@ -18,9 +18,9 @@ compile() {
 
   # Compile and capture any errors.
   if [[ "$OSTYPE" == "linux"* ]]; then
-    errs="$((g++ -std=c++11 -Wall -Wno-conversion -O3 -lGL -I/usr/local/include -L/usr/local/lib -lglfw3 -lGLEW $filepath -o $output) 2>&1)"
+    errs="$((g++ -std=c++11 -Wall -Wno-conversion -O3 -pthread -lGL -lEGL -I/usr/local/include -L/usr/local/lib -lglfw3 -lGLEW $filepath -o $output) 2>&1)"
   elif [[ "$OSTYPE" == "darwin"* ]]; then
-    errs="$((g++ -std=c++11 -Wall -Wno-conversion -O3 -framework OpenGL -I/usr/local/include -L/usr/local/lib -lglfw3 -lGLEW -lassimp $filepath -o $output) 2>&1)"
+    errs="$((g++ -std=c++11 -Wall -Wno-conversion -O3 -pthread -framework OpenGL -I/usr/local/include -L/usr/local/lib -lglfw3 -lGLEW -lassimp $filepath -o $output) 2>&1)"
   else
     echo "OS not supported"
     exit -1
@@ -37,8 +37,19 @@ run() {
   ./$output "$@"
 }
 
+benchmark() {
+  errs="$((g++ -std=c++11 -Wall -Wno-conversion -O3 -pthread -I/usr/local/include src/benchmark.cpp -o benchmark) 2>&1)"
+
+  if [[ ! -z "${errs//$'[[:space:]]'/}" ]]; then
+    echo "$errs"
+    exit -1
+  fi
+
+  ./benchmark
+}
+
 # check for flags
-while getopts ":uxr" opt; do
+while getopts ":uxrb" opt; do
   case $opt in
     u) # force update stb_image.h
       updateThirdParty=true
@@ -51,6 +62,9 @@ while getopts ":uxr" opt; do
       compile
       run "${@:2}"
       ;;
+    b) # compile and run the kernel benchmarks
+      benchmark
+      ;;
   esac
 done
 
@@ -0,0 +1,323 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "baker.hpp"
+
+/**
+ * Bake the given RGBA pixels into data laid out as a baked texture file: the
+ * header, then every mip level down to 1x1, each box filtered from the one
+ * before it and encoded in the smallest format that keeps the image's
+ * channels. The source attributes in the header are left for the caller.
+ */
+GLvoid bakeTexture(const GLubyte* pixels, GLuint width, GLuint height,
+                   GLuint options, std::vector<GLubyte>& data)
+{
+  TraceZone zone("bakeTexture");
+  TextureHeader header;
+  std::vector<GLubyte> level(pixels, pixels + width * height * 4), nextLevel;
+  GLuint64 offset = sizeof(TextureHeader);
+
+  memset(&header, 0, sizeof(TextureHeader));
+  header.magic = BAKED_TEXTURE_MAGIC;
+  header.version = BAKED_TEXTURE_VERSION;
+  header.format = chooseTextureFormat(pixels, width, height, options);
+  header.options = options;
+  header.width = width;
+  header.height = height;
+
+  for (GLuint w = width, h = height;
+       header.levelCount < BAKED_TEXTURE_LEVELS;
+       w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+    TextureLevel& record = header.levels[header.levelCount++];
+
+    record.offset = offset;
+    record.size = textureLevelSize(header.format, w, h);
+    record.width = w;
+    record.height = h;
+    offset += record.size;
+
+    if (w == 1 && h == 1) {
+      break;
+    }
+  }
+
+  data.resize(offset);
+  memcpy(data.data(), &header, sizeof(TextureHeader));
+
+  for (GLuint i = 0; i < header.levelCount; i++) {
+    const TextureLevel& record = header.levels[i];
+
+    if (i > 0) {
+      downsampleTexture(level.data(), header.levels[i - 1].width,
+                        header.levels[i - 1].height, nextLevel);
+      level.swap(nextLevel);
+    }
+
+    encodeTextureLevel(level.data(), record.width, record.height,
+                       header.format, &data[record.offset]);
+  }
+}
+
+/**
+ * Return the format to bake the given RGBA pixels in. Grey images without
+ * transparency only need their red channel, and opaque images no alpha.
+ */
+GLuint chooseTextureFormat(const GLubyte* pixels, GLuint width,
+                           GLuint height, GLuint options)
+{
+  GLuint isGrey = true, isOpaque = true;
+  GLuint isCompressed = options & BAKE_COMPRESSED;
+
+  for (GLuint i = 0; i < width * height; i++) {
+    const GLubyte* pixel = pixels + i * 4;
+
+    isGrey = isGrey && pixel[0] == pixel[1] && pixel[0] == pixel[2];
+    isOpaque = isOpaque && pixel[3] == 255;
+  }
+
+  if (isGrey && isOpaque) {
+    return isCompressed ? TEXTURE_BC4 : TEXTURE_R8;
+  } else if (isOpaque) {
+    return isCompressed ? TEXTURE_BC1 : TEXTURE_RGB8;
+  }
+
+  return isCompressed ? TEXTURE_BC3 : TEXTURE_RGBA8;
+}
+
+/**
+ * Return the size in bytes of a mip level with the given format and size.
+ */
+GLuint textureLevelSize(GLuint format, GLuint width, GLuint height)
+{
+  GLuint blockCount = ((width + 3) / 4) * ((height + 3) / 4);
+
+  switch (format) {
+    case TEXTURE_R8:
+      return width * height;
+    case TEXTURE_RGB8:
+      return width * height * 3;
+    case TEXTURE_BC1:
+    case TEXTURE_BC4:
+      return blockCount * 8;
+    case TEXTURE_BC3:
+      return blockCount * 16;
+  }
+
+  return width * height * 4;
+}
+
+/**
+ * Encode a mip level of RGBA pixels in the given format into the output. The
+ * pixels at the edges are repeated to fill partial compressed blocks.
+ */
+GLvoid encodeTextureLevel(const GLubyte* pixels, GLuint width, GLuint height,
+                          GLuint format, GLubyte* output)
+{
+  GLubyte block[16][4], alpha[16];
+
+  if (format == TEXTURE_R8 || format == TEXTURE_RGB8 ||
+      format == TEXTURE_RGBA8) {
+    GLuint channelCount = textureLevelSize(format, 1, 1);
+
+    for (GLuint i = 0; i < width * height; i++) {
+      memcpy(output + i * channelCount, pixels + i * 4, channelCount);
+    }
+
+    return;
+  }
+
+  for (GLuint y = 0; y < height; y += 4) {
+    for (GLuint x = 0; x < width; x += 4) {
+      for (GLuint i = 0; i < 16; i++) {
+        GLuint pixelX = std::min(x + i % 4, width - 1);
+        GLuint pixelY = std::min(y + i / 4, height - 1);
+
+        memcpy(block[i], pixels + (pixelY * width + pixelX) * 4, 4);
+        alpha[i] = block[i][(format == TEXTURE_BC4) ? 0 : 3];
+      }
+
+      if (format == TEXTURE_BC3) {
+        encodeAlphaBlock(alpha, output);
+        output += 8;
+      }
+
+      if (format == TEXTURE_BC4) {
+        encodeAlphaBlock(alpha, output);
+      } else {
+        encodeColourBlock(block, output);
+      }
+
+      output += 8;
+    }
+  }
+}
+
+/**
+ * Halve the size of a mip level of RGBA pixels with a box filter. A side of
+ * odd length repeats its last pixel, and a side of length 1 stays 1.
+ */
+GLvoid downsampleTexture(const GLubyte* pixels, GLuint width, GLuint height,
+                         std::vector<GLubyte>& output)
+{
+  GLuint outputWidth = std::max(width / 2, 1u);
+  GLuint outputHeight = std::max(height / 2, 1u);
+
+  output.resize(outputWidth * outputHeight * 4);
+
+  for (GLuint y = 0; y < outputHeight; y++) {
+    GLuint y0 = std::min(y * 2, height - 1);
+    GLuint y1 = std::min(y * 2 + 1, height - 1);
+
+    for (GLuint x = 0; x < outputWidth; x++) {
+      GLuint x0 = std::min(x * 2, width - 1);
+      GLuint x1 = std::min(x * 2 + 1, width - 1);
+
+      for (GLuint c = 0; c < 4; c++) {
+        output[(y * outputWidth + x) * 4 + c] =
+          (pixels[(y0 * width + x0) * 4 + c] +
+           pixels[(y0 * width + x1) * 4 + c] +
+           pixels[(y1 * width + x0) * 4 + c] +
+           pixels[(y1 * width + x1) * 4 + c] + 2) / 4;
+      }
+    }
+  }
+}
+
+/**
+ * Encode a 4x4 block of RGBA pixels as a BC1 colour block. The end points are
+ * the corners of the block's colour bounding box, inset by a sixteenth to
+ * reduce the error of the colours in between, and each pixel takes the
+ * nearest of the four palette colours.
+ */
+GLvoid encodeColourBlock(const GLubyte block[16][4], GLubyte* output)
+{
+  GLint minColour[3] = { 255, 255, 255 }, maxColour[3] = { 0, 0, 0 };
+  GLint palette[4][3];
+  GLushort endPoints[2];
+  GLuint indices = 0;
+
+  for (GLuint i = 0; i < 16; i++) {
+    for (GLuint c = 0; c < 3; c++) {
+      minColour[c] = std::min(minColour[c], (GLint)block[i][c]);
+      maxColour[c] = std::max(maxColour[c], (GLint)block[i][c]);
+    }
+  }
+
+  for (GLuint c = 0; c < 3; c++) {
+    GLint inset = (maxColour[c] - minColour[c]) / 16;
+
+    minColour[c] += inset;
+    maxColour[c] -= inset;
+  }
+
+  // Pack the end points as RGB 5:6:5, with the larger first so the block
+  // uses four colours.
+  endPoints[0] = ((maxColour[0] * 31 + 127) / 255) << 11 |
+                 ((maxColour[1] * 63 + 127) / 255) << 5 |
+                 ((maxColour[2] * 31 + 127) / 255);
+  endPoints[1] = ((minColour[0] * 31 + 127) / 255) << 11 |
+                 ((minColour[1] * 63 + 127) / 255) << 5 |
+                 ((minColour[2] * 31 + 127) / 255);
+
+  if (endPoints[0] < endPoints[1]) {
+    std::swap(endPoints[0], endPoints[1]);
+  }
+
+  for (GLuint i = 0; i < 2; i++) {
+    GLuint red = endPoints[i] >> 11;
+    GLuint green = (endPoints[i] >> 5) & 0x3f;
+    GLuint blue = endPoints[i] & 0x1f;
+
+    palette[i][0] = (red << 3) | (red >> 2);
+    palette[i][1] = (green << 2) | (green >> 4);
+    palette[i][2] = (blue << 3) | (blue >> 2);
+  }
+
+  for (GLuint c = 0; c < 3; c++) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+
+  // Equal end points leave the block in three colour mode, so use index 0.
+  if (endPoints[0] != endPoints[1]) {
+    for (GLuint i = 0; i < 16; i++) {
+      GLint bestDistance = 0x7fffffff;
+      GLuint bestIndex = 0;
+
+      for (GLuint j = 0; j < 4; j++) {
+        GLint distance = 0;
+
+        for (GLuint c = 0; c < 3; c++) {
+          GLint difference = block[i][c] - palette[j][c];
+          distance += difference * difference;
+        }
+
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          bestIndex = j;
+        }
+      }
+
+      indices |= bestIndex << (i * 2);
+    }
+  }
+
+  output[0] = endPoints[0] & 0xff;
+  output[1] = endPoints[0] >> 8;
+  output[2] = endPoints[1] & 0xff;
+  output[3] = endPoints[1] >> 8;
+
+  for (GLuint i = 0; i < 4; i++) {
+    output[4 + i] = (indices >> (i * 8)) & 0xff;
+  }
+}
+
+/**
+ * Encode 16 single channel values as a BC4 block, which is also the alpha
+ * block of BC3. The end points are the smallest and largest value, with six
+ * values interpolated between them, and each value takes the nearest.
+ */
+GLvoid encodeAlphaBlock(const GLubyte values[16], GLubyte* output)
+{
+  GLint minValue = 255, maxValue = 0, palette[8];
+  GLuint64 indices = 0;
+
+  for (GLuint i = 0; i < 16; i++) {
+    minValue = std::min(minValue, (GLint)values[i]);
+    maxValue = std::max(maxValue, (GLint)values[i]);
+  }
+
+  palette[0] = maxValue;
+  palette[1] = minValue;
+
+  for (GLuint i = 1; i < 7; i++) {
+    palette[i + 1] = ((7 - i) * maxValue + i * minValue) / 7;
+  }
+
+  for (GLuint i = 0; i < 16 && maxValue != minValue; i++) {
+    GLint bestDistance = 256;
+    GLuint bestIndex = 0;
+
+    for (GLuint j = 0; j < 8; j++) {
+      GLint distance = abs(values[i] - palette[j]);
+
+      if (distance < bestDistance) {
+        bestDistance = distance;
+        bestIndex = j;
+      }
+    }
+
+    indices |= (GLuint64)bestIndex << (i * 3);
+  }
+
+  output[0] = maxValue;
+  output[1] = minValue;
+
+  for (GLuint i = 0; i < 6; i++) {
+    output[2 + i] = (indices >> (i * 8)) & 0xff;
+  }
+}
@@ -0,0 +1,66 @@
+/**
+ * [Program description]
+ */
+
+#ifndef BAKER_HEADER
+#define BAKER_HEADER
+
+#include <vector>
+
+#define BAKED_TEXTURE_MAGIC     0x58544d4d // "MMTX"
+#define BAKED_TEXTURE_VERSION   1
+#define BAKED_TEXTURE_EXTENSION ".tex"
+#define BAKED_TEXTURE_LEVELS    16
+
+// Bake options that change the baked data, and so the baked file.
+#define BAKE_COMPRESSED 0x1
+
+/**
+ * The formats of baked textures. Single channel images are stored as red
+ * only, and images without transparency without alpha. The block compressed
+ * formats store each 4x4 block of pixels in 8 (BC1, BC4) or 16 (BC3) bytes.
+ */
+enum TextureFormat {
+  TEXTURE_R8, TEXTURE_RGB8, TEXTURE_RGBA8, TEXTURE_BC1, TEXTURE_BC3, TEXTURE_BC4
+};
+
+struct TextureLevel {
+  GLuint64 offset;
+  GLuint size;
+  GLuint width;
+  GLuint height;
+  GLuint reserved;
+};
+
+/**
+ * A baked texture file starts with this header, followed by the data of each
+ * mip level, from the largest to the smallest, that the level records point
+ * into. The source attributes are those of the image it was baked from.
+ */
+struct TextureHeader {
+  GLuint magic;
+  GLuint version;
+  GLuint format;
+  GLuint options;
+  GLuint width;
+  GLuint height;
+  GLuint levelCount;
+  GLuint reserved;
+  GLuint64 sourceSize;
+  GLint64 sourceTime;
+  TextureLevel levels[BAKED_TEXTURE_LEVELS];
+};
+
+GLvoid bakeTexture(const GLubyte* pixels, GLuint width, GLuint height,
+                   GLuint options, std::vector<GLubyte>& data);
+GLuint chooseTextureFormat(const GLubyte* pixels, GLuint width,
+                           GLuint height, GLuint options);
+GLuint textureLevelSize(GLuint format, GLuint width, GLuint height);
+GLvoid encodeTextureLevel(const GLubyte* pixels, GLuint width, GLuint height,
+                          GLuint format, GLubyte* output);
+GLvoid downsampleTexture(const GLubyte* pixels, GLuint width, GLuint height,
+                         std::vector<GLubyte>& output);
+GLvoid encodeColourBlock(const GLubyte block[16][4], GLubyte* output);
+GLvoid encodeAlphaBlock(const GLubyte values[16], GLubyte* output);
+
+#endif
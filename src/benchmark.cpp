@@ -0,0 +1,193 @@
+/**
+ * Benchmark of the position kernels against the scalar bounding box and
+ * normalisation loops they replaced. Build and run with ./build.sh -b.
+ */
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "helpers.hpp"
+#include "kernels.cpp"
+
+#define BENCHMARK_VERTEX_COUNT 10000000
+#define BENCHMARK_MESH_COUNT   16
+#define BENCHMARK_REPEATS      5
+
+// The same layout as a model vertex: position, normal, texture coordinates.
+struct BenchmarkVertex {
+  GLfloat position[3];
+  GLfloat normal[3];
+  GLfloat textureCoords[2];
+};
+
+std::vector<BenchmarkVertex> vertices(BENCHMARK_VERTEX_COUNT);
+
+// Stops the compiler from removing loops whose results are otherwise unused.
+volatile GLfloat benchmarkSink;
+
+/**
+ * The bounding box loop from before the kernels, including its else if.
+ */
+GLvoid findBoundsReference(glm::vec3& min, glm::vec3& max)
+{
+  for (GLuint i = 0; i < vertices.size(); i++) {
+    const GLfloat* vector = vertices[i].position;
+
+    for (GLuint j = 0; j < 3; j++) {
+      if (vector[j] < min[j]) {
+        min[j] = vector[j];
+      } else if (vector[j] > max[j]) {
+        max[j] = vector[j];
+      }
+    }
+  }
+}
+
+/**
+ * The normalisation loop from before the kernels, normalising along x.
+ */
+GLvoid normalizeReference(GLfloat min, GLfloat max, glm::vec3 lower,
+                          glm::vec3 upper)
+{
+  GLfloat size = max - min;
+  GLfloat scaleFactor = 1.0f / (upper.x - lower.x);
+
+  for (GLuint i = 0; i < vertices.size(); i++) {
+    GLfloat* position = vertices[i].position;
+
+    position[0] = size * (position[0] - lower.x) / (upper.x - lower.x) + min;
+    position[1] = size * (position[1] * scaleFactor);
+    position[2] = size * (position[2] * scaleFactor);
+  }
+}
+
+/**
+ * Find the bounds of the vertices split into meshes, one mesh per task.
+ */
+GLvoid findBounds(KernelLevel level, GLuint threadCount, glm::vec3& min,
+                  glm::vec3& max)
+{
+  GLuint meshSize = vertices.size() / BENCHMARK_MESH_COUNT;
+  std::vector<glm::vec3> minimums(BENCHMARK_MESH_COUNT, min);
+  std::vector<glm::vec3> maximums(BENCHMARK_MESH_COUNT, max);
+
+  parallelFor(BENCHMARK_MESH_COUNT, threadCount, [&](GLuint i) {
+    GLuint count = (i == BENCHMARK_MESH_COUNT - 1) ?
+                   vertices.size() - i * meshSize : meshSize;
+    findPositionBounds(vertices[i * meshSize].position, count,
+                       sizeof(BenchmarkVertex) / sizeof(GLfloat),
+                       minimums[i], maximums[i], level);
+  });
+
+  for (GLuint i = 0; i < BENCHMARK_MESH_COUNT; i++) {
+    min = glm::min(min, minimums[i]);
+    max = glm::max(max, maximums[i]);
+  }
+}
+
+GLvoid remap(KernelLevel level, GLuint threadCount, glm::vec3 scale,
+             glm::vec3 offset)
+{
+  GLuint meshSize = vertices.size() / BENCHMARK_MESH_COUNT;
+
+  parallelFor(BENCHMARK_MESH_COUNT, threadCount, [&](GLuint i) {
+    GLuint count = (i == BENCHMARK_MESH_COUNT - 1) ?
+                   vertices.size() - i * meshSize : meshSize;
+    remapPositions(vertices[i * meshSize].position, count,
+                   sizeof(BenchmarkVertex) / sizeof(GLfloat),
+                   scale, offset, level);
+  });
+}
+
+/**
+ * Return the fastest time of the given function in milliseconds.
+ */
+GLdouble timeFunction(std::function<GLvoid()> function)
+{
+  GLdouble fastest = std::numeric_limits<GLdouble>::max();
+
+  for (GLuint i = 0; i < BENCHMARK_REPEATS; i++) {
+    GLdouble start = currentTime();
+    function();
+    fastest = std::min(fastest, (currentTime() - start) * 1000.0);
+  }
+
+  return fastest;
+}
+
+GLint main(GLint argc, GLchar* argv[])
+{
+  GLfloat maxFloatValue = std::numeric_limits<GLfloat>::max();
+  glm::vec3 expectedMin(maxFloatValue), expectedMax(-maxFloatValue);
+  GLuint threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  GLdouble time;
+
+  srand(0);
+
+  for (GLuint i = 0; i < vertices.size(); i++) {
+    for (GLuint j = 0; j < 3; j++) {
+      vertices[i].position[j] = randomNumber(-100.0f, 100.0f);
+      vertices[i].normal[j] = randomNumber(-1.0f, 1.0f);
+    }
+  }
+
+  findBounds(KERNEL_SCALAR, 1, expectedMin, expectedMax);
+
+  printf("%u vertices in %u meshes, best of %u runs, %s supported\n\n",
+         BENCHMARK_VERTEX_COUNT, BENCHMARK_MESH_COUNT, BENCHMARK_REPEATS,
+         kernelLevelName(supportedKernelLevel()));
+  printf("%-26s %10s %10s\n", "", "bounds", "remap");
+
+  time = timeFunction([&]() {
+    glm::vec3 min(maxFloatValue), max(-maxFloatValue);
+    findBoundsReference(min, max);
+    benchmarkSink = min.x + min.y + min.z + max.x + max.y + max.z;
+  });
+  printf("%-26s %8.2fms", "reference loops", time);
+
+  // Normalise onto the current range, so the positions barely change.
+  time = timeFunction([&]() {
+    normalizeReference(expectedMin.x, expectedMax.x, expectedMin,
+                       expectedMax);
+  });
+  printf(" %8.2fms\n", time);
+
+  expectedMin = glm::vec3(maxFloatValue);
+  expectedMax = glm::vec3(-maxFloatValue);
+  findBounds(KERNEL_SCALAR, 1, expectedMin, expectedMax);
+
+  for (GLuint level = KERNEL_SCALAR; level <= supportedKernelLevel();
+       level++) {
+    for (GLuint threads = 1; threads <= threadCount;
+         threads = (threads == threadCount) ? threads + 1 : threadCount) {
+      GLchar name[64];
+      glm::vec3 min, max;
+
+      snprintf(name, sizeof(name), "%s, %u thread(s)",
+               kernelLevelName((KernelLevel)level), threads);
+
+      time = timeFunction([&]() {
+        min = glm::vec3(maxFloatValue);
+        max = glm::vec3(-maxFloatValue);
+        findBounds((KernelLevel)level, threads, min, max);
+      });
+      printf("%-26s %8.2fms", name, time);
+
+      time = timeFunction([&]() {
+        remap((KernelLevel)level, threads, glm::vec3(1.0f), glm::vec3(0.0f));
+      });
+      printf(" %8.2fms", time);
+
+      if (min != expectedMin || max != expectedMax) {
+        printf("  (bounds differ from the scalar kernel)");
+      }
+
+      printf("\n");
+    }
+  }
+
+  return 0;
+}
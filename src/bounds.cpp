@@ -0,0 +1,208 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+
+#include "bounds.hpp"
+
+/**
+ * Return the bounds that enclose both a and b. The sphere is the one around
+ * the merged box, which is looser than the tightest enclosing sphere.
+ */
+Bounds mergeBounds(const Bounds& a, const Bounds& b)
+{
+  Bounds merged;
+
+  merged.min = glm::min(a.min, b.min);
+  merged.max = glm::max(a.max, b.max);
+  merged.center = (merged.min + merged.max) * 0.5f;
+  merged.radius = glm::length(merged.max - merged.center);
+
+  return merged;
+}
+
+/**
+ * Scale each plane so its normal is unit length, so that plugging a point
+ * into the plane gives its signed distance.
+ */
+GLvoid normalizePlanes(glm::vec4* planes)
+{
+  for (GLuint i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+    GLfloat length = glm::length(glm::vec3(planes[i]));
+
+    if (length > 0.0f) {
+      planes[i] = planes[i] / length;
+    }
+  }
+}
+
+/**
+ * Test the bounds against the (normalized, inward facing) frustum planes.
+ * The sphere is tested first since it is cheaper, and the box is only tested
+ * against the planes that the sphere crosses.
+ */
+FrustumTest testFrustum(const Bounds& bounds, const glm::vec4* planes)
+{
+  FrustumTest result = FRUSTUM_INSIDE;
+
+  for (GLuint i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+    glm::vec3 normal(planes[i]);
+    GLfloat distance = glm::dot(normal, bounds.center) + planes[i].w;
+
+    if (distance < -bounds.radius) {
+      return FRUSTUM_OUTSIDE;
+    } else if (distance >= bounds.radius) {
+      continue;
+    }
+
+    // The box corners furthest along and against the plane's normal.
+    glm::vec3 positive(normal.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                       normal.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                       normal.z >= 0.0f ? bounds.max.z : bounds.min.z);
+    glm::vec3 negative(normal.x >= 0.0f ? bounds.min.x : bounds.max.x,
+                       normal.y >= 0.0f ? bounds.min.y : bounds.max.y,
+                       normal.z >= 0.0f ? bounds.min.z : bounds.max.z);
+
+    if (glm::dot(normal, positive) + planes[i].w < 0.0f) {
+      return FRUSTUM_OUTSIDE;
+    }
+
+    if (glm::dot(normal, negative) + planes[i].w < 0.0f) {
+      result = FRUSTUM_INTERSECT;
+    }
+  }
+
+  return result;
+}
+
+BoundsTree::BoundsTree()
+{
+}
+
+/**
+ * Build the hierarchy over the given item bounds by splitting each node at
+ * the median item along the longest axis of the item centers.
+ */
+GLvoid BoundsTree::build(const std::vector<Bounds>& itemBounds)
+{
+  bounds = itemBounds;
+  items.resize(bounds.size());
+  nodes.clear();
+
+  for (GLuint i = 0; i < items.size(); i++) {
+    items[i] = i;
+  }
+
+  if (items.empty()) {
+    return;
+  }
+
+  // A binary tree with leaves of at least one item has under 2n nodes.
+  nodes.reserve(2 * items.size());
+  nodes.push_back(BoundsNode());
+  buildNode(0, 0, items.size());
+}
+
+/**
+ * Add the items whose bounds are inside or intersect the given frustum planes
+ * to visibleItems. Subtrees entirely inside the frustum are added without
+ * testing their items, and subtrees outside are skipped.
+ */
+GLvoid BoundsTree::cull(const glm::vec4* planes,
+                        std::vector<GLuint>& visibleItems)
+{
+  if (!nodes.empty()) {
+    cullNode(0, planes, visibleItems);
+  }
+}
+
+GLvoid BoundsTree::buildNode(GLuint node, GLuint first, GLuint count)
+{
+  Bounds nodeBounds = bounds[items[first]];
+  glm::vec3 minCenter = nodeBounds.center, maxCenter = nodeBounds.center;
+  GLuint axis = 0;
+
+  for (GLuint i = first + 1; i < first + count; i++) {
+    nodeBounds = mergeBounds(nodeBounds, bounds[items[i]]);
+    minCenter = glm::min(minCenter, bounds[items[i]].center);
+    maxCenter = glm::max(maxCenter, bounds[items[i]].center);
+  }
+
+  nodes[node].bounds = nodeBounds;
+  nodes[node].first = first;
+  nodes[node].count = count;
+
+  if (count <= BOUNDS_LEAF_SIZE) {
+    return;
+  }
+
+  glm::vec3 extent = maxCenter - minCenter;
+
+  if (extent.y > extent[axis]) {
+    axis = 1;
+  }
+  if (extent.z > extent[axis]) {
+    axis = 2;
+  }
+
+  GLuint half = count / 2;
+  const std::vector<Bounds>& itemBounds = bounds;
+
+  std::nth_element(items.begin() + first, items.begin() + first + half,
+                   items.begin() + first + count,
+                   [&itemBounds, axis](GLuint a, GLuint b) {
+                     return itemBounds[a].center[axis] <
+                            itemBounds[b].center[axis];
+                   });
+
+  GLuint child = nodes.size();
+
+  nodes[node].first = child;
+  nodes[node].count = 0;
+  nodes.push_back(BoundsNode());
+  nodes.push_back(BoundsNode());
+
+  buildNode(child, first, half);
+  buildNode(child + 1, first + half, count - half);
+}
+
+GLvoid BoundsTree::cullNode(GLuint node, const glm::vec4* planes,
+                            std::vector<GLuint>& visibleItems)
+{
+  FrustumTest result = testFrustum(nodes[node].bounds, planes);
+
+  if (result == FRUSTUM_OUTSIDE) {
+    return;
+  } else if (result == FRUSTUM_INSIDE) {
+    addItems(node, visibleItems);
+    return;
+  }
+
+  if (nodes[node].count == 0) {
+    cullNode(nodes[node].first, planes, visibleItems);
+    cullNode(nodes[node].first + 1, planes, visibleItems);
+    return;
+  }
+
+  for (GLuint i = 0; i < nodes[node].count; i++) {
+    GLuint item = items[nodes[node].first + i];
+
+    if (testFrustum(bounds[item], planes) != FRUSTUM_OUTSIDE) {
+      visibleItems.push_back(item);
+    }
+  }
+}
+
+GLvoid BoundsTree::addItems(GLuint node, std::vector<GLuint>& visibleItems)
+{
+  if (nodes[node].count == 0) {
+    addItems(nodes[node].first, visibleItems);
+    addItems(nodes[node].first + 1, visibleItems);
+    return;
+  }
+
+  for (GLuint i = 0; i < nodes[node].count; i++) {
+    visibleItems.push_back(items[nodes[node].first + i]);
+  }
+}
@@ -0,0 +1,59 @@
+/**
+ * [Program description]
+ */
+
+#ifndef BOUNDS_HEADER
+#define BOUNDS_HEADER
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#define FRUSTUM_PLANE_COUNT 6
+#define BOUNDS_LEAF_SIZE    2
+
+enum FrustumTest { FRUSTUM_OUTSIDE, FRUSTUM_INTERSECT, FRUSTUM_INSIDE };
+
+/**
+ * An axis-aligned bounding box with the bounding sphere around its center.
+ */
+struct Bounds {
+  glm::vec3 min;
+  glm::vec3 max;
+  glm::vec3 center;
+  GLfloat radius;
+};
+
+/**
+ * A node of a bounding volume hierarchy. Leaf nodes hold count items starting
+ * at first, and other nodes have a count of zero and their two children at
+ * first and first + 1.
+ */
+struct BoundsNode {
+  Bounds bounds;
+  GLuint first;
+  GLuint count;
+};
+
+Bounds mergeBounds(const Bounds& a, const Bounds& b);
+GLvoid normalizePlanes(glm::vec4* planes);
+FrustumTest testFrustum(const Bounds& bounds, const glm::vec4* planes);
+
+class BoundsTree
+{
+  public:
+    BoundsTree();
+    GLvoid build(const std::vector<Bounds>& itemBounds);
+    GLvoid cull(const glm::vec4* planes, std::vector<GLuint>& visibleItems);
+
+  private:
+    std::vector<BoundsNode> nodes;
+    std::vector<GLuint> items;
+    std::vector<Bounds> bounds;
+
+    GLvoid buildNode(GLuint node, GLuint first, GLuint count);
+    GLvoid cullNode(GLuint node, const glm::vec4* planes,
+                    std::vector<GLuint>& visibleItems);
+    GLvoid addItems(GLuint node, std::vector<GLuint>& visibleItems);
+};
+
+#endif
@@ -0,0 +1,309 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hpp"
+
+/**
+ * Constructor to create a cache for the given model source file and import
+ * options. The cache file is stored next to the source file.
+ */
+ModelCache::ModelCache(std::string modelFilepath, GLuint importOptions)
+{
+  sourceFilepath = modelFilepath;
+  filepath = modelFilepath + MODEL_CACHE_EXTENSION;
+  options = importOptions;
+  header = NULL;
+  data = NULL;
+  size = 0;
+}
+
+/**
+ * Map the cache file into memory. Returns true if the cache exists and still
+ * matches the source file, otherwise the cache is closed and false returned.
+ */
+GLuint ModelCache::open()
+{
+  struct stat attributes;
+  GLint fd = ::open(filepath.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  if (fstat(fd, &attributes) != 0 ||
+      (size_t)attributes.st_size < sizeof(CacheHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  size = attributes.st_size;
+  data = (GLubyte*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    data = NULL;
+    size = 0;
+    return false;
+  }
+
+  header = (const CacheHeader*)data;
+
+  if (!isValid()) {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+GLvoid ModelCache::close()
+{
+  if (data) {
+    munmap(data, size);
+  }
+
+  header = NULL;
+  data = NULL;
+  size = 0;
+}
+
+/**
+ * Write the given meshes and bounding box to the cache file. The file is
+ * written to a temporary path first and then renamed so that a partially
+ * written cache is never picked up by another run.
+ */
+GLuint ModelCache::write(const std::vector<Mesh>& meshes,
+                         GLfloat minX, GLfloat maxX, GLfloat minY,
+                         GLfloat maxY, GLfloat minZ, GLfloat maxZ)
+{
+  using namespace std;
+
+  TraceZone zone("ModelCache::write");
+  CacheHeader cacheHeader;
+  vector<CacheMesh> records(meshes.size());
+  vector<GLchar> textureData;
+  GLuint64 offset;
+  string temporaryFilepath = filepath + ".tmp";
+
+  cacheHeader.magic = MODEL_CACHE_MAGIC;
+  cacheHeader.version = MODEL_CACHE_VERSION;
+  cacheHeader.vertexSize = sizeof(Vertex);
+  cacheHeader.meshCount = meshes.size();
+  cacheHeader.options = options;
+  cacheHeader.reserved = 0;
+  cacheHeader.sourceHash = hashFile(sourceFilepath);
+  cacheHeader.minX = minX;
+  cacheHeader.maxX = maxX;
+  cacheHeader.minY = minY;
+  cacheHeader.maxY = maxY;
+  cacheHeader.minZ = minZ;
+  cacheHeader.maxZ = maxZ;
+
+  if (!readSourceAttributes(&cacheHeader.sourceSize,
+                            &cacheHeader.sourceTime)) {
+    return false;
+  }
+
+  // Lay out the vertex data, then the index data, then the meshlets, then the
+  // texture references.
+  offset = sizeof(CacheHeader) + records.size() * sizeof(CacheMesh);
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    records[i].vertexOffset = offset;
+    records[i].vertexCount = meshes[i].vertices.size();
+    offset += meshes[i].vertices.size() * sizeof(Vertex);
+  }
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    records[i].indexOffset = offset;
+    records[i].indexCount = meshes[i].indices.size();
+    records[i].lodIndexCount = meshes[i].lodIndices.size();
+    records[i].lodCount = std::min((GLuint)meshes[i].lods.size(),
+                                   (GLuint)MAX_MESH_LODS);
+    std::copy(meshes[i].lods.begin(),
+              meshes[i].lods.begin() + records[i].lodCount, records[i].lods);
+    offset += (meshes[i].indices.size() + meshes[i].lodIndices.size()) *
+              sizeof(GLuint);
+  }
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    records[i].meshletOffset = offset;
+    records[i].meshletCount = meshes[i].meshlets.size();
+    offset += meshes[i].meshlets.size() * sizeof(Meshlet);
+  }
+
+  // Each texture reference is stored as its type and file path, both
+  // terminated by a null character.
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    records[i].textureOffset = offset + textureData.size();
+    records[i].textureCount = meshes[i].textures.size();
+
+    for (GLuint j = 0; j < meshes[i].textures.size(); j++) {
+      const Texture& texture = meshes[i].textures[j];
+      const GLchar* path = texture.filepath.C_Str();
+
+      textureData.insert(textureData.end(), texture.type.begin(),
+                                            texture.type.end());
+      textureData.push_back('\0');
+      textureData.insert(textureData.end(), path, path + strlen(path));
+      textureData.push_back('\0');
+    }
+
+    records[i].textureSize = offset + textureData.size() -
+                             records[i].textureOffset;
+  }
+
+  ofstream file(temporaryFilepath, ios::binary | ios::trunc);
+
+  if (!file.is_open()) {
+    fprintf(stderr, "\nFailed to write model cache: %s\n",
+            temporaryFilepath.c_str());
+    return false;
+  }
+
+  file.write((const GLchar*)&cacheHeader, sizeof(CacheHeader));
+  file.write((const GLchar*)records.data(),
+             records.size() * sizeof(CacheMesh));
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    file.write((const GLchar*)meshes[i].vertices.data(),
+               meshes[i].vertices.size() * sizeof(Vertex));
+  }
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    file.write((const GLchar*)meshes[i].indices.data(),
+               meshes[i].indices.size() * sizeof(GLuint));
+    file.write((const GLchar*)meshes[i].lodIndices.data(),
+               meshes[i].lodIndices.size() * sizeof(GLuint));
+  }
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    file.write((const GLchar*)meshes[i].meshlets.data(),
+               meshes[i].meshlets.size() * sizeof(Meshlet));
+  }
+
+  file.write(textureData.data(), textureData.size());
+  file.close();
+
+  if (!file || rename(temporaryFilepath.c_str(), filepath.c_str()) != 0) {
+    fprintf(stderr, "\nFailed to write model cache: %s\n", filepath.c_str());
+    unlink(temporaryFilepath.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Create a mesh from the given cached mesh record. The texture references
+ * are returned with their file paths and types only, so they still need to
+ * be loaded.
+ */
+Mesh ModelCache::readMesh(GLuint index)
+{
+  const CacheMesh* record = (const CacheMesh*)(data + sizeof(CacheHeader)) +
+                            index;
+  const Vertex* vertices = (const Vertex*)(data + record->vertexOffset);
+  const GLuint* indices = (const GLuint*)(data + record->indexOffset);
+  const GLuint* lodIndices = indices + record->indexCount;
+  const Meshlet* meshlets = (const Meshlet*)(data + record->meshletOffset);
+  const GLchar* textureData = (const GLchar*)(data + record->textureOffset);
+  std::vector<Texture> textures(record->textureCount);
+
+  for (GLuint i = 0; i < record->textureCount; i++) {
+    textures[i].id = 0;
+    textures[i].layer = 0;
+    textures[i].type = textureData;
+    textureData += textures[i].type.size() + 1;
+    textures[i].filepath.Set(textureData);
+    textureData += textures[i].filepath.length + 1;
+  }
+
+  Mesh mesh(std::vector<Vertex>(vertices, vertices + record->vertexCount),
+            std::vector<GLuint>(indices, indices + record->indexCount),
+            textures);
+
+  mesh.lodIndices.assign(lodIndices, lodIndices + record->lodIndexCount);
+  mesh.lods.assign(record->lods, record->lods + record->lodCount);
+  mesh.meshlets.assign(meshlets, meshlets + record->meshletCount);
+
+  return mesh;
+}
+
+GLuint ModelCache::readSourceAttributes(GLuint64* sourceSize,
+                                        GLint64* sourceTime)
+{
+  struct stat attributes;
+
+  if (stat(sourceFilepath.c_str(), &attributes) != 0) {
+    return false;
+  }
+
+  *sourceSize = attributes.st_size;
+  *sourceTime = attributes.st_mtime;
+
+  return true;
+}
+
+/**
+ * Check the mapped cache against the current version and the source file.
+ * The source file is only hashed if its modification time has changed, in
+ * which case the cache is still used if the content is the same.
+ */
+GLuint ModelCache::isValid()
+{
+  GLuint64 sourceSize;
+  GLint64 sourceTime;
+  const CacheMesh* records = (const CacheMesh*)(data + sizeof(CacheHeader));
+
+  if (header->magic != MODEL_CACHE_MAGIC ||
+      header->version != MODEL_CACHE_VERSION ||
+      header->vertexSize != sizeof(Vertex) ||
+      header->options != options ||
+      sizeof(CacheHeader) + header->meshCount * sizeof(CacheMesh) > size) {
+    return false;
+  }
+
+  if (!readSourceAttributes(&sourceSize, &sourceTime) ||
+      sourceSize != header->sourceSize) {
+    return false;
+  }
+
+  if (sourceTime != header->sourceTime) {
+    if (hashFile(sourceFilepath) != header->sourceHash) {
+      return false;
+    }
+
+    // Keep the content match so the source is not hashed again next time.
+    GLint fd = ::open(filepath.c_str(), O_WRONLY);
+
+    if (fd >= 0) {
+      pwrite(fd, &sourceTime, sizeof(sourceTime),
+             offsetof(CacheHeader, sourceTime));
+      ::close(fd);
+    }
+  }
+
+  // Make sure a truncated or corrupt cache is never read past its end.
+  for (GLuint i = 0; i < header->meshCount; i++) {
+    if (records[i].vertexOffset +
+        (GLuint64)records[i].vertexCount * sizeof(Vertex) > size ||
+        records[i].indexOffset + ((GLuint64)records[i].indexCount +
+        records[i].lodIndexCount) * sizeof(GLuint) > size ||
+        records[i].lodCount > MAX_MESH_LODS ||
+        records[i].meshletOffset +
+        (GLuint64)records[i].meshletCount * sizeof(Meshlet) > size ||
+        records[i].textureOffset + records[i].textureSize > size) {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,78 @@
+/**
+ * [Program description]
+ */
+
+#ifndef CACHE_HEADER
+#define CACHE_HEADER
+
+#include <string>
+#include <vector>
+#include "mesh.hpp"
+
+#define MODEL_CACHE_MAGIC     0x48434d4d // "MMCH"
+#define MODEL_CACHE_VERSION   5
+#define MODEL_CACHE_EXTENSION ".cache"
+
+/**
+ * The cache file starts with a header, followed by one record per mesh, then
+ * the vertex, index, meshlet and texture reference data that the records
+ * point into.
+ * The options are the import options the meshes were converted with, so a
+ * cache is only reused by an import with the same options.
+ */
+struct CacheHeader {
+  GLuint magic;
+  GLuint version;
+  GLuint vertexSize;
+  GLuint meshCount;
+  GLuint options;
+  GLuint reserved;
+  GLuint64 sourceSize;
+  GLint64 sourceTime;
+  GLuint64 sourceHash;
+  GLfloat minX, maxX, minY, maxY, minZ, maxZ;
+};
+
+/**
+ * A mesh's indices are followed by the indices of its levels of detail.
+ */
+struct CacheMesh {
+  GLuint64 vertexOffset;
+  GLuint64 indexOffset;
+  GLuint64 textureOffset;
+  GLuint64 meshletOffset;
+  GLuint vertexCount;
+  GLuint indexCount;
+  GLuint textureCount;
+  GLuint textureSize;
+  GLuint lodIndexCount;
+  GLuint lodCount;
+  GLuint meshletCount;
+  MeshLod lods[MAX_MESH_LODS];
+};
+
+class ModelCache
+{
+  public:
+    const CacheHeader* header;
+
+    ModelCache(std::string sourceFilepath = "", GLuint importOptions = 0);
+    GLuint open();
+    GLvoid close();
+    GLuint write(const std::vector<Mesh>& meshes,
+                 GLfloat minX, GLfloat maxX, GLfloat minY,
+                 GLfloat maxY, GLfloat minZ, GLfloat maxZ);
+    Mesh readMesh(GLuint index);
+
+  private:
+    std::string sourceFilepath;
+    std::string filepath;
+    GLuint options;
+    GLubyte* data;
+    size_t size;
+
+    GLuint readSourceAttributes(GLuint64* sourceSize, GLint64* sourceTime);
+    GLuint isValid();
+};
+
+#endif
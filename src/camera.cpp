@@ -34,11 +34,37 @@ Camera::Camera(glm::vec3 desiredPosition, glm::vec3 desiredUp,
 GLvoid Camera::updatePerspective()
 {
   projection = glm::perspective(glm::radians(fov), aspectRatio, near, far);
+  updateFrustumPlanes();
 }
 
 GLvoid Camera::updateLookAtMatrix()
 {
   view = glm::lookAt(position, position + front, up);
+  updateFrustumPlanes();
+}
+
+/**
+ * Extract the world space frustum planes from the view-projection matrix, in
+ * the order left, right, bottom, top, near, far. Each plane's normal points
+ * into the frustum.
+ */
+GLvoid Camera::updateFrustumPlanes()
+{
+  glm::mat4 matrix = projection * view;
+  glm::vec4 rows[4];
+
+  for (GLuint i = 0; i < 4; i++) {
+    rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+  }
+
+  frustumPlanes[0] = rows[3] + rows[0];
+  frustumPlanes[1] = rows[3] - rows[0];
+  frustumPlanes[2] = rows[3] + rows[1];
+  frustumPlanes[3] = rows[3] - rows[1];
+  frustumPlanes[4] = rows[3] + rows[2];
+  frustumPlanes[5] = rows[3] - rows[2];
+
+  normalizePlanes(frustumPlanes);
 }
 
 GLvoid Camera::updatePosition(Direction direction, GLfloat distance)
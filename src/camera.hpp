@@ -6,6 +6,7 @@
 #define CAMERA_HEADER
 
 #include <glm/glm.hpp>
+#include "bounds.hpp"
 
 class Camera
 {
@@ -23,6 +24,7 @@ class Camera
 
     glm::mat4 view;
     glm::mat4 projection;
+    glm::vec4 frustumPlanes[FRUSTUM_PLANE_COUNT];
 
     GLfloat yaw;
     GLfloat pitch;
@@ -44,6 +46,7 @@ class Camera
            GLfloat desiredZoomMultiplier = 40.0f);
     GLvoid updatePerspective();
     GLvoid updateLookAtMatrix();
+    GLvoid updateFrustumPlanes();
     GLvoid updatePosition(Direction direction, GLfloat deltaTime);
     GLvoid updateOrientation(GLfloat deltaYaw, GLfloat deltaPitch);
     GLvoid setPitch(GLfloat desiredPitch);
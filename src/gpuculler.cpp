@@ -0,0 +1,264 @@
+/**
+ * [Program description]
+ */
+
+#include <map>
+#include <utility>
+
+#include "gpuculler.hpp"
+
+GpuCuller::GpuCuller()
+{
+  vao = meshBuffer = batchOffsetBuffer = layerBuffer = 0;
+  commandBuffer = countBuffer = 0;
+  meshCount = slotCount = nextSlot = 0;
+}
+
+/**
+ * Create the buffers for culling the given meshes, grouped into batches by
+ * their textures, and the vertex array to draw them with, which is left bound
+ * without any vertex buffer attributes. Returns false if the context does
+ * not support compute shaders and indirect draws (OpenGL 4.3).
+ */
+GLuint GpuCuller::create(const std::vector<Mesh>& meshes)
+{
+  TraceZone zone("GpuCuller::create");
+  std::map<std::pair<GLuint, GLuint>, GLuint> batches;
+  std::vector<CullMesh> records;
+  std::vector<glm::ivec2> layers;
+  std::vector<GLuint> order;
+
+  if (!GLEW_VERSION_4_3 || meshes.empty()) {
+    return false;
+  }
+
+  // Find the batch of each mesh, keyed by its diffuse and specular arrays.
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    GLuint diffuseID = 0, specularID = 0;
+
+    for (GLuint j = 0; j < meshes[i].textures.size(); j++) {
+      const Texture& texture = meshes[i].textures[j];
+
+      if (texture.type == "diffuse" && !diffuseID) {
+        diffuseID = texture.id;
+      } else if (texture.type == "specular" && !specularID) {
+        specularID = texture.id;
+      }
+    }
+
+    std::pair<GLuint, GLuint> key(diffuseID, specularID);
+
+    if (!batches.count(key)) {
+      batches[key] = batchSizes.size();
+      batchSizes.push_back(0);
+      batchMeshes.push_back(i);
+    }
+
+    order.push_back(batches[key]);
+    batchSizes[batches[key]]++;
+  }
+
+  // Each batch has a range of the draw commands as large as the batch.
+  meshCount = meshes.size();
+  batchOffsets.resize(batchSizes.size());
+
+  for (GLuint i = 1; i < batchSizes.size(); i++) {
+    batchOffsets[i] = batchOffsets[i - 1] + batchSizes[i - 1];
+  }
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    CullMesh record;
+
+    record.sphere = glm::vec4(meshes[i].bounds.center,
+                              meshes[i].bounds.radius);
+    record.indexCount = meshes[i].indexCount;
+    record.firstIndex = meshes[i].firstIndex;
+    record.baseVertex = meshes[i].baseVertex;
+    record.batch = order[i];
+    records.push_back(record);
+    layers.push_back(meshes[i].textureLayers());
+  }
+
+  glGenBuffers(1, &meshBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, records.size() * sizeof(CullMesh),
+               records.data(), GL_STATIC_DRAW);
+
+  glGenBuffers(1, &batchOffsetBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, batchOffsetBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, batchOffsets.size() * sizeof(GLuint),
+               batchOffsets.data(), GL_STATIC_DRAW);
+
+  glGenBuffers(1, &commandBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GPU_CULL_SLOTS * meshCount *
+               sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+
+  glGenBuffers(1, &countBuffer);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               GPU_CULL_SLOTS * batchSizes.size() * sizeof(GLuint), NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  // The layers of each draw are read with its base instance, the mesh index.
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &layerBuffer);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, layerBuffer);
+  glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(glm::ivec2),
+               layers.data(), GL_STATIC_DRAW);
+  glEnableVertexAttribArray(MATERIAL_LAYERS_ATTRIBUTE);
+  glVertexAttribIPointer(MATERIAL_LAYERS_ATTRIBUTE, 2, GL_INT,
+                         sizeof(glm::ivec2), (GLvoid*)0);
+  glVertexAttribDivisor(MATERIAL_LAYERS_ATTRIBUTE, 1);
+
+  zone.addArgument("batches", (GLuint64)batchSizes.size());
+
+  return true;
+}
+
+GLvoid GpuCuller::destroy()
+{
+  if (vao) {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &meshBuffer);
+    glDeleteBuffers(1, &batchOffsetBuffer);
+    glDeleteBuffers(1, &layerBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &countBuffer);
+  }
+
+  vao = meshBuffer = batchOffsetBuffer = layerBuffer = 0;
+  commandBuffer = countBuffer = 0;
+  meshCount = 0;
+  reset();
+  batchOffsets.clear();
+  batchSizes.clear();
+  batchMeshes.clear();
+}
+
+/**
+ * Forget the planes of every slot, so that the next cull of each runs again.
+ */
+GLvoid GpuCuller::reset()
+{
+  slotCount = nextSlot = 0;
+}
+
+GLuint GpuCuller::isCreated() const
+{
+  return vao != 0;
+}
+
+GLuint GpuCuller::vertexArray() const
+{
+  return vao;
+}
+
+GLuint GpuCuller::batchCount() const
+{
+  return batchSizes.size();
+}
+
+/**
+ * Return the index of the first mesh of the given batch, which has the
+ * batch's textures.
+ */
+GLuint GpuCuller::batchMesh(GLuint batch) const
+{
+  return batchMeshes[batch];
+}
+
+/**
+ * Cull the meshes against the given (normalized, model space) frustum planes,
+ * or keep every mesh if there are none, with the given compute program. The
+ * draw commands of the meshes that are left are compacted to the start of
+ * their batch's range in the returned slot, and the rest are zeroed.
+ */
+GLuint GpuCuller::cull(const Shader& program, const glm::vec4* planes)
+{
+  glm::vec4 cullPlanes[FRUSTUM_PLANE_COUNT];
+  GLuint slot, commandOffset, countOffset, groupCount;
+  GLuint zero = 0;
+
+  // Planes that every sphere is in front of keep every mesh.
+  for (GLuint i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+    cullPlanes[i] = planes ? planes[i] : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  }
+
+  for (slot = 0; slot < slotCount; slot++) {
+    if (std::equal(cullPlanes, cullPlanes + FRUSTUM_PLANE_COUNT,
+                   slotPlanes[slot])) {
+      return slot;
+    }
+  }
+
+  slot = nextSlot;
+  nextSlot = (nextSlot + 1) % GPU_CULL_SLOTS;
+  slotCount = std::max(slotCount, slot + 1);
+  std::copy(cullPlanes, cullPlanes + FRUSTUM_PLANE_COUNT, slotPlanes[slot]);
+
+  commandOffset = slot * meshCount;
+  countOffset = slot * batchSizes.size();
+  groupCount = (meshCount + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE;
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+  glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI,
+                       commandOffset * sizeof(DrawElementsIndirectCommand),
+                       meshCount * sizeof(DrawElementsIndirectCommand),
+                       GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+  glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI,
+                       countOffset * sizeof(GLuint),
+                       batchSizes.size() * sizeof(GLuint),
+                       GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, meshBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batchOffsetBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, countBuffer);
+
+  glUseProgram(program.id);
+  glUniform4fv(program.uniform("frustumPlanes"), FRUSTUM_PLANE_COUNT,
+               &cullPlanes[0][0]);
+  glUniform1ui(program.uniform("meshCount"), meshCount);
+  glUniform1ui(program.uniform("commandOffset"), commandOffset);
+  glUniform1ui(program.uniform("countOffset"), countOffset);
+  glDispatchCompute(groupCount, 1, 1);
+  glUseProgram(0);
+
+  // The draws read the commands and counts as indirect parameters.
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+  return slot;
+}
+
+/**
+ * Draw the meshes of the given batch that were left by the cull that returned
+ * the slot. The vertex array and the batch's textures must be bound. Without
+ * indirect parameters, the zeroed commands after the compacted ones are drawn
+ * too, but draw nothing.
+ */
+GLvoid GpuCuller::draw(GLuint slot, GLuint batch) const
+{
+  GLintptr commandOffset = (slot * meshCount + batchOffsets[batch]) *
+                           sizeof(DrawElementsIndirectCommand);
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+
+  if (GLEW_ARB_indirect_parameters) {
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+    glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                        (GLvoid*)commandOffset,
+                                        (slot * batchSizes.size() + batch) *
+                                        sizeof(GLuint), batchSizes[batch], 0);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+  } else {
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                (GLvoid*)commandOffset, batchSizes[batch], 0);
+  }
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
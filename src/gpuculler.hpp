@@ -0,0 +1,79 @@
+/**
+ * [Program description]
+ */
+
+#ifndef GPU_CULLER_HEADER
+#define GPU_CULLER_HEADER
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "bounds.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+
+#define GPU_CULL_SLOTS      4
+#define GPU_CULL_GROUP_SIZE 64
+
+// The layouts of the std430 buffers read and written by cull.comp.
+struct CullMesh {
+  glm::vec4 sphere;
+  GLuint indexCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint batch;
+};
+
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+/**
+ * Culls a model's meshes against the frustum on the GPU and draws the meshes
+ * that are left with one multi-draw-indirect per batch. A batch is the meshes
+ * that use the same textures, as textures cannot change within a draw.
+ *
+ * Each cull writes its draw commands to one of several slots, and a cull with
+ * the same planes as a slot reuses it, so the model can be drawn with a few
+ * different transforms in a frame, and not be culled again while it stays
+ * still. The material layers of each draw are an instanced attribute of its
+ * own vertex array, indexed through the draw's base instance.
+ *
+ * The mesh bounds are copied by create, so anything that changes them must
+ * create the culler again, and anything else that changes what a cull keeps
+ * must reset the slots.
+ */
+class GpuCuller
+{
+  public:
+    GpuCuller();
+    GLuint create(const std::vector<Mesh>& meshes);
+    GLvoid destroy();
+    GLuint isCreated() const;
+    GLuint vertexArray() const;
+    GLuint batchCount() const;
+    GLuint batchMesh(GLuint batch) const;
+    GLuint cull(const Shader& program, const glm::vec4* planes);
+    GLvoid draw(GLuint slot, GLuint batch) const;
+    GLvoid reset();
+
+  private:
+    GLuint vao;
+    GLuint meshBuffer;
+    GLuint batchOffsetBuffer;
+    GLuint layerBuffer;
+    GLuint commandBuffer;
+    GLuint countBuffer;
+    GLuint meshCount;
+    std::vector<GLuint> batchOffsets;
+    std::vector<GLuint> batchSizes;
+    std::vector<GLuint> batchMeshes;
+    glm::vec4 slotPlanes[GPU_CULL_SLOTS][FRUSTUM_PLANE_COUNT];
+    GLuint slotCount;
+    GLuint nextSlot;
+};
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * [Program description]
+ */
+
+#include "gputimer.hpp"
+
+GpuTimer::GpuTimer()
+{
+  enabled = false;
+  frame = 0;
+  activePass = -1;
+  memset(queries, 0, sizeof(queries));
+  memset(isPending, 0, sizeof(isPending));
+  reset();
+}
+
+/**
+ * Create the query objects and start timing. This needs a current context.
+ */
+GLvoid GpuTimer::initialise()
+{
+  glGenQueries(GPU_TIMER_FRAMES * GPU_TIMER_PASSES, &queries[0][0]);
+  enabled = true;
+}
+
+GLvoid GpuTimer::destroy()
+{
+  if (enabled) {
+    glDeleteQueries(GPU_TIMER_FRAMES * GPU_TIMER_PASSES, &queries[0][0]);
+  }
+
+  enabled = false;
+}
+
+GLuint GpuTimer::isEnabled() const
+{
+  return enabled;
+}
+
+/**
+ * Start timing the given pass, ending the pass being timed if there is one.
+ */
+GLvoid GpuTimer::begin(GLuint pass)
+{
+  if (!enabled) {
+    return;
+  }
+
+  end();
+
+  // The last result from this query never arrived, so it is dropped.
+  if (isPending[frame][pass]) {
+    isPending[frame][pass] = false;
+    droppedCounts[pass]++;
+  }
+
+  glBeginQuery(GL_TIME_ELAPSED, queries[frame][pass]);
+  activePass = pass;
+}
+
+GLvoid GpuTimer::end()
+{
+  if (!enabled || activePass < 0) {
+    return;
+  }
+
+  glEndQuery(GL_TIME_ELAPSED);
+  isPending[frame][activePass] = true;
+  activePass = -1;
+}
+
+/**
+ * End the frame and move on to the next set of queries, then read back every
+ * result that has become available.
+ */
+GLvoid GpuTimer::endFrame()
+{
+  if (!enabled) {
+    return;
+  }
+
+  end();
+  frame = (frame + 1) % GPU_TIMER_FRAMES;
+  collect();
+}
+
+/**
+ * Clear every sample, such as between benchmark scenarios.
+ */
+GLvoid GpuTimer::reset()
+{
+  memset(samples, 0, sizeof(samples));
+  memset(sampleCounts, 0, sizeof(sampleCounts));
+  memset(totalTimes, 0, sizeof(totalTimes));
+  memset(totalCounts, 0, sizeof(totalCounts));
+  memset(droppedCounts, 0, sizeof(droppedCounts));
+}
+
+/**
+ * Return the average time of the pass over the last GPU_TIMER_SAMPLES frames
+ * it was drawn in, in milliseconds.
+ */
+GLdouble GpuTimer::averageTime(GLuint pass) const
+{
+  GLuint count = std::min(sampleCounts[pass], (GLuint)GPU_TIMER_SAMPLES);
+  GLdouble sum = 0.0;
+
+  for (GLuint i = 0; i < count; i++) {
+    sum += samples[pass][i];
+  }
+
+  return count ? sum / count : 0.0;
+}
+
+/**
+ * Return the average time of the pass since the last reset, in milliseconds.
+ */
+GLdouble GpuTimer::meanTime(GLuint pass) const
+{
+  return totalCounts[pass] ? totalTimes[pass] / totalCounts[pass] : 0.0;
+}
+
+/**
+ * Return the number of results of every pass dropped since the last reset.
+ */
+GLuint GpuTimer::droppedCount() const
+{
+  GLuint count = 0;
+
+  for (GLuint pass = 0; pass < GPU_TIMER_PASSES; pass++) {
+    count += droppedCounts[pass];
+  }
+
+  return count;
+}
+
+GLvoid GpuTimer::collect()
+{
+  GLint isAvailable;
+  GLuint64 elapsedTime;
+  GLdouble time;
+
+  for (GLuint i = 0; i < GPU_TIMER_FRAMES; i++) {
+    for (GLuint pass = 0; pass < GPU_TIMER_PASSES; pass++) {
+      if (!isPending[i][pass]) {
+        continue;
+      }
+
+      glGetQueryObjectiv(queries[i][pass], GL_QUERY_RESULT_AVAILABLE,
+                         &isAvailable);
+
+      if (!isAvailable) {
+        continue;
+      }
+
+      glGetQueryObjectui64v(queries[i][pass], GL_QUERY_RESULT, &elapsedTime);
+      isPending[i][pass] = false;
+
+      time = elapsedTime / 1000000.0;
+      samples[pass][sampleCounts[pass]++ % GPU_TIMER_SAMPLES] = time;
+      totalTimes[pass] += time;
+      totalCounts[pass]++;
+    }
+  }
+}
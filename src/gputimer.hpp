@@ -0,0 +1,49 @@
+/**
+ * [Program description]
+ */
+
+#ifndef GPU_TIMER_HEADER
+#define GPU_TIMER_HEADER
+
+#define GPU_TIMER_PASSES  16
+#define GPU_TIMER_FRAMES  4
+#define GPU_TIMER_SAMPLES 60
+
+/**
+ * Times render passes on the GPU with GL_TIME_ELAPSED queries. Each frame
+ * uses its own set of queries, so the results of earlier frames can be read
+ * once they are available without waiting on the GPU. A result that is
+ * still not available when its query is needed again is dropped and counted,
+ * so that averages over too few samples can be told apart.
+ */
+class GpuTimer
+{
+  public:
+    GpuTimer();
+    GLvoid initialise();
+    GLvoid destroy();
+    GLuint isEnabled() const;
+    GLvoid begin(GLuint pass);
+    GLvoid end();
+    GLvoid endFrame();
+    GLvoid reset();
+    GLdouble averageTime(GLuint pass) const;
+    GLdouble meanTime(GLuint pass) const;
+    GLuint droppedCount() const;
+
+  private:
+    GLuint enabled;
+    GLuint frame;
+    GLint activePass;
+    GLuint queries[GPU_TIMER_FRAMES][GPU_TIMER_PASSES];
+    GLuint isPending[GPU_TIMER_FRAMES][GPU_TIMER_PASSES];
+    GLdouble samples[GPU_TIMER_PASSES][GPU_TIMER_SAMPLES];
+    GLuint sampleCounts[GPU_TIMER_PASSES];
+    GLdouble totalTimes[GPU_TIMER_PASSES];
+    GLuint totalCounts[GPU_TIMER_PASSES];
+    GLuint droppedCounts[GPU_TIMER_PASSES];
+
+    GLvoid collect();
+};
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * [Program description]
+ */
+
+#include "headless.hpp"
+
+HeadlessContext::HeadlessContext()
+{
+#ifdef HEADLESS_EGL
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+#endif
+  framebuffer = 0;
+  renderbuffers[0] = renderbuffers[1] = 0;
+}
+
+/**
+ * Create an OpenGL 3.3 core context and make it current, with a framebuffer
+ * of the given size bound for drawing. Returns false if EGL or the context
+ * could not be initialised.
+ */
+GLuint HeadlessContext::create(GLuint width, GLuint height)
+{
+#ifndef HEADLESS_EGL
+  return false;
+#else
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+    eglGetProcAddress("eglGetPlatformDisplayEXT");
+  EGLint majorVersion, minorVersion, configCount;
+  EGLConfig config;
+  EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+
+  if (getPlatformDisplay) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, NULL);
+  }
+
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  if (display == EGL_NO_DISPLAY ||
+      !eglInitialize(display, &majorVersion, &minorVersion) ||
+      !eglBindAPI(EGL_OPENGL_API) ||
+      !eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+      configCount == 0) {
+    return false;
+  }
+
+  context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                             contextAttributes);
+
+  // Without a surface, the context draws into the framebuffer created below.
+  if (context == EGL_NO_CONTEXT ||
+      !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    return false;
+  }
+
+  // GLEW fails to find a GLX display here, but only after it has loaded the
+  // core functions, so check the version it found instead of its result.
+  glewExperimental = GL_TRUE;
+  glewInit();
+
+  if (!GLEW_VERSION_3_3) {
+    return false;
+  }
+
+  glGenFramebuffers(1, &framebuffer);
+  glGenRenderbuffers(2, renderbuffers);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, renderbuffers[0]);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, renderbuffers[1]);
+
+  return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+#endif
+}
+
+GLvoid HeadlessContext::destroy()
+{
+  if (framebuffer) {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+    framebuffer = 0;
+  }
+
+#ifdef HEADLESS_EGL
+  if (display != EGL_NO_DISPLAY) {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (context != EGL_NO_CONTEXT) {
+      eglDestroyContext(display, context);
+    }
+
+    eglTerminate(display);
+  }
+
+  display = EGL_NO_DISPLAY;
+  context = EGL_NO_CONTEXT;
+#endif
+}
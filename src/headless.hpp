@@ -0,0 +1,36 @@
+/**
+ * [Program description]
+ */
+
+#ifndef HEADLESS_HEADER
+#define HEADLESS_HEADER
+
+// EGL is only available on Linux, so elsewhere create always fails.
+#ifdef __linux__
+#define HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+/**
+ * An OpenGL context without a window, rendering into its own framebuffer.
+ * It uses Mesa's surfaceless EGL platform if there is one, so it also runs
+ * with software rendering (llvmpipe) on machines without a GPU or display.
+ */
+class HeadlessContext
+{
+  public:
+    HeadlessContext();
+    GLuint create(GLuint width, GLuint height);
+    GLvoid destroy();
+
+  private:
+#ifdef HEADLESS_EGL
+    EGLDisplay display;
+    EGLContext context;
+#endif
+    GLuint framebuffer;
+    GLuint renderbuffers[2];
+};
+
+#endif
@@ -5,11 +5,16 @@
 #ifndef HELPER_HEADER
 #define HELPER_HEADER
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <math.h>
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 /**
@@ -37,21 +42,149 @@ GLfloat average(std::initializer_list<GLfloat> values)
 }
 
 /**
- * Read the whole content of a given file into a char array.
+ * Return a monotonic time in seconds. Unlike glfwGetTime, this can be called
+ * from any thread and before the graphics libraries are initialised.
  */
-const GLchar* readFile(std::string filename)
+GLdouble currentTime()
+{
+  using namespace std::chrono;
+
+  return duration<GLdouble>(steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Call the given function for every index from 0 to count - 1 on a pool of
+ * threads. If no thread count is given, one thread per hardware thread is
+ * used.
+ */
+GLvoid parallelFor(GLuint count, GLuint threadCount,
+                   std::function<GLvoid(GLuint)> function)
+{
+  std::vector<std::thread> threads;
+  std::atomic<GLuint> nextIndex(0);
+
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  threadCount = std::min(threadCount, count);
+
+  if (threadCount <= 1) {
+    for (GLuint i = 0; i < count; i++) {
+      function(i);
+    }
+
+    return;
+  }
+
+  for (GLuint i = 0; i < threadCount; i++) {
+    threads.push_back(std::thread([&]() {
+      GLuint index;
+
+      while ((index = nextIndex++) < count) {
+        function(index);
+      }
+    }));
+  }
+
+  for (GLuint i = 0; i < threadCount; i++) {
+    threads[i].join();
+  }
+}
+
+/**
+ * Check if the given file name ends with the given extension, ignoring case.
+ */
+GLuint hasExtension(std::string filename, std::string extension)
+{
+  if (filename.size() < extension.size()) {
+    return false;
+  }
+
+  for (GLuint i = 0; i < extension.size(); i++) {
+    GLchar character = filename[filename.size() - extension.size() + i];
+
+    if (tolower(character) != tolower(extension[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Read the whole content of a given file into a string.
+ */
+std::string readFile(std::string filename)
 {
   using namespace std;
 
   ifstream file(filename);
   stringstream buffer;
-  string* contents;
 
   buffer << file.rdbuf();
   file.close();
-  contents = new string(buffer.str());
 
-  return contents->c_str();
+  return buffer.str();
+}
+
+/**
+ * Return the given percentile (0 - 100) of the values, using the nearest
+ * rank.
+ */
+GLdouble percentile(std::vector<GLdouble> values, GLdouble rank)
+{
+  GLint index;
+
+  if (values.empty()) {
+    return 0.0;
+  }
+
+  std::sort(values.begin(), values.end());
+  index = (GLint)ceil(rank / 100.0 * values.size()) - 1;
+
+  return values[std::min(std::max(index, 0), (GLint)values.size() - 1)];
+}
+
+/**
+ * Hash a block of bytes using 64-bit FNV-1a. The hash can be continued over
+ * several blocks by passing the previous result as the seed.
+ */
+GLuint64 hashBytes(const GLvoid* data, size_t size,
+                   GLuint64 seed = 0xcbf29ce484222325ULL)
+{
+  const GLubyte* bytes = (const GLubyte*)data;
+  GLuint64 hash = seed;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+/**
+ * Hash the whole content of a given file. Returns 0 if it cannot be read.
+ */
+GLuint64 hashFile(std::string filename)
+{
+  using namespace std;
+
+  ifstream file(filename, ios::binary);
+  GLchar buffer[1 << 16];
+  GLuint64 hash = hashBytes(NULL, 0);
+
+  if (!file.is_open()) {
+    return 0;
+  }
+
+  while (file) {
+    file.read(buffer, sizeof(buffer));
+    hash = hashBytes(buffer, file.gcount(), hash);
+  }
+
+  return hash;
 }
 
 /**
@@ -0,0 +1,249 @@
+/**
+ * [Program description]
+ */
+
+#include "kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Return the best kernel level the CPU supports. It is only checked once.
+ */
+KernelLevel supportedKernelLevel()
+{
+#ifdef KERNELS_X86
+  static KernelLevel level = __builtin_cpu_supports("avx") ? KERNEL_AVX :
+                             __builtin_cpu_supports("sse4.1") ? KERNEL_SSE41 :
+                             KERNEL_SCALAR;
+  return level;
+#else
+  return KERNEL_SCALAR;
+#endif
+}
+
+const GLchar* kernelLevelName(KernelLevel level)
+{
+  switch (level) {
+    case KERNEL_SSE41: return "SSE4.1";
+    case KERNEL_AVX:   return "AVX";
+    default:           return "scalar";
+  }
+}
+
+static GLvoid findPositionBoundsScalar(const GLfloat* positions, GLuint count,
+                                       GLuint stride, glm::vec3& min,
+                                       glm::vec3& max)
+{
+  GLfloat minX = min.x, minY = min.y, minZ = min.z;
+  GLfloat maxX = max.x, maxY = max.y, maxZ = max.z;
+
+  for (GLuint i = 0; i < count; i++, positions += stride) {
+    minX = positions[0] < minX ? positions[0] : minX;
+    minY = positions[1] < minY ? positions[1] : minY;
+    minZ = positions[2] < minZ ? positions[2] : minZ;
+    maxX = positions[0] > maxX ? positions[0] : maxX;
+    maxY = positions[1] > maxY ? positions[1] : maxY;
+    maxZ = positions[2] > maxZ ? positions[2] : maxZ;
+  }
+
+  min = glm::vec3(minX, minY, minZ);
+  max = glm::vec3(maxX, maxY, maxZ);
+}
+
+static GLvoid remapPositionsScalar(GLfloat* positions, GLuint count,
+                                   GLuint stride, glm::vec3 scale,
+                                   glm::vec3 offset)
+{
+  for (GLuint i = 0; i < count; i++, positions += stride) {
+    for (GLuint j = 0; j < 3; j++) {
+      positions[j] = positions[j] * scale[j] + offset[j];
+    }
+  }
+}
+
+#ifdef KERNELS_X86
+
+/**
+ * The SSE versions hold one position per register, with the lane after z
+ * ignored for the bounds and kept unchanged by the remap. Four accumulators
+ * are used so consecutive positions do not wait on each other.
+ */
+__attribute__((target("sse4.1")))
+static GLvoid findPositionBoundsSse(const GLfloat* positions, GLuint count,
+                                    GLuint stride, glm::vec3& min,
+                                    glm::vec3& max)
+{
+  __m128 minimum[4], maximum[4];
+  GLuint i = 0;
+
+  for (GLuint j = 0; j < 4; j++) {
+    minimum[j] = _mm_setr_ps(min.x, min.y, min.z, 0.0f);
+    maximum[j] = _mm_setr_ps(max.x, max.y, max.z, 0.0f);
+  }
+
+  for (; i + 4 <= count; i += 4, positions += 4 * stride) {
+    for (GLuint j = 0; j < 4; j++) {
+      __m128 position = _mm_loadu_ps(positions + j * stride);
+      minimum[j] = _mm_min_ps(minimum[j], position);
+      maximum[j] = _mm_max_ps(maximum[j], position);
+    }
+  }
+
+  for (; i < count; i++, positions += stride) {
+    __m128 position = _mm_loadu_ps(positions);
+    minimum[0] = _mm_min_ps(minimum[0], position);
+    maximum[0] = _mm_max_ps(maximum[0], position);
+  }
+
+  minimum[0] = _mm_min_ps(_mm_min_ps(minimum[0], minimum[1]),
+                          _mm_min_ps(minimum[2], minimum[3]));
+  maximum[0] = _mm_max_ps(_mm_max_ps(maximum[0], maximum[1]),
+                          _mm_max_ps(maximum[2], maximum[3]));
+
+  GLfloat result[4];
+
+  _mm_storeu_ps(result, minimum[0]);
+  min = glm::vec3(result[0], result[1], result[2]);
+  _mm_storeu_ps(result, maximum[0]);
+  max = glm::vec3(result[0], result[1], result[2]);
+}
+
+__attribute__((target("sse4.1")))
+static GLvoid remapPositionsSse(GLfloat* positions, GLuint count,
+                                GLuint stride, glm::vec3 scale,
+                                glm::vec3 offset)
+{
+  __m128 scales = _mm_setr_ps(scale.x, scale.y, scale.z, 1.0f);
+  __m128 offsets = _mm_setr_ps(offset.x, offset.y, offset.z, 0.0f);
+
+  for (GLuint i = 0; i < count; i++, positions += stride) {
+    __m128 position = _mm_loadu_ps(positions);
+    __m128 result = _mm_add_ps(_mm_mul_ps(position, scales), offsets);
+    _mm_storeu_ps(positions, _mm_blend_ps(result, position, 0x8));
+  }
+}
+
+/**
+ * The AVX versions hold two positions per register, one in each half.
+ */
+__attribute__((target("avx")))
+static GLvoid findPositionBoundsAvx(const GLfloat* positions, GLuint count,
+                                    GLuint stride, glm::vec3& min,
+                                    glm::vec3& max)
+{
+  __m256 minimum[4], maximum[4];
+  GLuint i = 0;
+
+  for (GLuint j = 0; j < 4; j++) {
+    minimum[j] = _mm256_setr_ps(min.x, min.y, min.z, 0.0f,
+                                min.x, min.y, min.z, 0.0f);
+    maximum[j] = _mm256_setr_ps(max.x, max.y, max.z, 0.0f,
+                                max.x, max.y, max.z, 0.0f);
+  }
+
+  for (; i + 8 <= count; i += 8, positions += 8 * stride) {
+    for (GLuint j = 0; j < 4; j++) {
+      const GLfloat* pair = positions + 2 * j * stride;
+      __m256 position = _mm256_insertf128_ps(
+                          _mm256_castps128_ps256(_mm_loadu_ps(pair)),
+                          _mm_loadu_ps(pair + stride), 1);
+      minimum[j] = _mm256_min_ps(minimum[j], position);
+      maximum[j] = _mm256_max_ps(maximum[j], position);
+    }
+  }
+
+  minimum[0] = _mm256_min_ps(_mm256_min_ps(minimum[0], minimum[1]),
+                             _mm256_min_ps(minimum[2], minimum[3]));
+  maximum[0] = _mm256_max_ps(_mm256_max_ps(maximum[0], maximum[1]),
+                             _mm256_max_ps(maximum[2], maximum[3]));
+
+  __m128 lowerMinimum = _mm_min_ps(_mm256_castps256_ps128(minimum[0]),
+                                   _mm256_extractf128_ps(minimum[0], 1));
+  __m128 lowerMaximum = _mm_max_ps(_mm256_castps256_ps128(maximum[0]),
+                                   _mm256_extractf128_ps(maximum[0], 1));
+
+  for (; i < count; i++, positions += stride) {
+    __m128 position = _mm_loadu_ps(positions);
+    lowerMinimum = _mm_min_ps(lowerMinimum, position);
+    lowerMaximum = _mm_max_ps(lowerMaximum, position);
+  }
+
+  GLfloat result[4];
+
+  _mm_storeu_ps(result, lowerMinimum);
+  min = glm::vec3(result[0], result[1], result[2]);
+  _mm_storeu_ps(result, lowerMaximum);
+  max = glm::vec3(result[0], result[1], result[2]);
+}
+
+__attribute__((target("avx")))
+static GLvoid remapPositionsAvx(GLfloat* positions, GLuint count,
+                                GLuint stride, glm::vec3 scale,
+                                glm::vec3 offset)
+{
+  __m256 scales = _mm256_setr_ps(scale.x, scale.y, scale.z, 1.0f,
+                                 scale.x, scale.y, scale.z, 1.0f);
+  __m256 offsets = _mm256_setr_ps(offset.x, offset.y, offset.z, 0.0f,
+                                  offset.x, offset.y, offset.z, 0.0f);
+  GLuint i = 0;
+
+  for (; i + 2 <= count; i += 2, positions += 2 * stride) {
+    __m256 position = _mm256_insertf128_ps(
+                        _mm256_castps128_ps256(_mm_loadu_ps(positions)),
+                        _mm_loadu_ps(positions + stride), 1);
+    __m256 result = _mm256_add_ps(_mm256_mul_ps(position, scales), offsets);
+
+    result = _mm256_blend_ps(result, position, 0x88);
+    _mm_storeu_ps(positions, _mm256_castps256_ps128(result));
+    _mm_storeu_ps(positions + stride, _mm256_extractf128_ps(result, 1));
+  }
+
+  if (i < count) {
+    remapPositionsScalar(positions, count - i, stride, scale, offset);
+  }
+}
+
+#endif
+
+/**
+ * Widen min and max to include every position. Pass min and max as the
+ * largest and smallest floats to find the bounds of the positions alone.
+ */
+GLvoid findPositionBounds(const GLfloat* positions, GLuint count,
+                          GLuint stride, glm::vec3& min, glm::vec3& max,
+                          KernelLevel level)
+{
+#ifdef KERNELS_X86
+  if (stride >= 4 && level == KERNEL_AVX) {
+    findPositionBoundsAvx(positions, count, stride, min, max);
+    return;
+  } else if (stride >= 4 && level == KERNEL_SSE41) {
+    findPositionBoundsSse(positions, count, stride, min, max);
+    return;
+  }
+#endif
+
+  findPositionBoundsScalar(positions, count, stride, min, max);
+}
+
+/**
+ * Set each position p to p * scale + offset.
+ */
+GLvoid remapPositions(GLfloat* positions, GLuint count, GLuint stride,
+                      glm::vec3 scale, glm::vec3 offset, KernelLevel level)
+{
+#ifdef KERNELS_X86
+  if (stride >= 4 && level == KERNEL_AVX) {
+    remapPositionsAvx(positions, count, stride, scale, offset);
+    return;
+  } else if (stride >= 4 && level == KERNEL_SSE41) {
+    remapPositionsSse(positions, count, stride, scale, offset);
+    return;
+  }
+#endif
+
+  remapPositionsScalar(positions, count, stride, scale, offset);
+}
@@ -0,0 +1,28 @@
+/**
+ * [Program description]
+ */
+
+#ifndef KERNELS_HEADER
+#define KERNELS_HEADER
+
+#include <glm/glm.hpp>
+
+/**
+ * The instruction sets the position kernels are built for. Each kernel runs
+ * on a strided view of positions (x, y, z followed by stride - 3 other
+ * floats), so they work directly on the interleaved vertex arrays. The vector
+ * versions read a fourth float after each position, so they need a stride of
+ * at least 4 and fall back to the scalar version otherwise.
+ */
+enum KernelLevel { KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX };
+
+KernelLevel supportedKernelLevel();
+const GLchar* kernelLevelName(KernelLevel level);
+GLvoid findPositionBounds(const GLfloat* positions, GLuint count,
+                          GLuint stride, glm::vec3& min, glm::vec3& max,
+                          KernelLevel level = supportedKernelLevel());
+GLvoid remapPositions(GLfloat* positions, GLuint count, GLuint stride,
+                      glm::vec3 scale, glm::vec3 offset,
+                      KernelLevel level = supportedKernelLevel());
+
+#endif
@@ -12,6 +12,14 @@ GLfloat aspectRatio;
 // environment info
 const GLchar* profile;
 std::map<std::string, GLfloat> env;
+std::map<std::string, GLfloat> profileEnv;
+const GLchar* modelOptionNames[] = {
+  "isModelCacheEnabled", "textureThreadCount", "isObjLoaderEnabled",
+  "isMeshOptimizationEnabled", "isDirectImportEnabled", "isGpuResidentEnabled",
+  "isTextureBakingEnabled", "isTextureCompressionEnabled",
+  "isTexturePackingEnabled", "isMeshLodEnabled", "isMeshletEnabled",
+  "isPositionStreamEnabled"
+};
 
 // keyboard info
 GLuint keyPressed[512];
@@ -32,6 +40,13 @@ glm::vec3 backgroundColour(0.0f);
 glm::vec3 lightPosition(0.0f);
 GLuint isPointLightingEnabled;
 GLuint isCullingEnabled;
+GLuint isFrustumCullingEnabled;
+GLuint isGpuCullingEnabled;
+GLuint featureInstanceCount;
+GLuint isLodSelectionEnabled;
+GLuint isMeshletCullingEnabled;
+GLuint isVertexPullingEnabled;
+GLfloat lodPixelError;
 GLuint areFacesEnabled;
 GLuint areNormalsEnabled;
 GLuint isWireframeEnabled;
@@ -42,10 +57,42 @@ GLfloat shineValue = 1.0f;
 GLfloat normalLength;
 GLfloat outlineSize;
 
-Shader simpleShader, normalShader, outlineShader;
+Shader simpleShader, normalShader, outlineShader, cullShader;
+Shader faceShader, wireframeShader, normalLineShader;
+GLuint frameUniformBuffer;
 Model featureModel, lightModel;
+RenderQueue renderQueue;
+const GLchar* renderPassNames[] = { "faces", "normals", "outline", "light" };
+GLfloat lastGpuTimePrintTime = 0.0f;
 std::string featureModelPath, lightModelPath;
 
+// hot reload info
+FileWatcher fileWatcher;
+Model reloadedModel;
+Model* reloadTarget = NULL;
+std::set<Model*> queuedReloadTargets;
+std::thread modelReloadThread;
+std::atomic<GLuint> isModelReloadReady(false);
+
+// benchmark info
+GLuint isBenchmarkEnabled = false;
+std::string benchmarkOutputPath;
+HeadlessContext headlessContext;
+BenchmarkScenario benchmarkScenarios[] = {
+  // name             faces wireframe normals outline culling instanced pulled
+  { "faces",            1,      0,       0,      0,      0,       0,       0 },
+  { "faces-culled",     1,      0,       0,      0,      1,       0,       0 },
+  { "wireframe",        0,      1,       0,      0,      0,       0,       0 },
+  { "faces-wireframe",  1,      1,       0,      0,      0,       0,       0 },
+  { "normals",          1,      0,       1,      0,      0,       0,       0 },
+  { "outline",          1,      0,       0,      1,      0,       0,       0 },
+  { "all",              1,      1,       1,      1,      1,       0,       0 },
+  { "instanced-grid",   1,      0,       0,      0,      1,       1,       0 },
+  { "faces-pulled",     1,      0,       0,      0,      0,       0,       1 },
+  { "wireframe-pulled", 0,      1,       0,      0,      0,       0,       1 },
+  { "normals-pulled",   1,      0,       1,      0,      0,       0,       1 }
+};
+
 /**
  * Listen for keyboard events.
  */
@@ -74,6 +121,26 @@ GLvoid keyboard(GLFWwindow* window, GLint key, GLint scancode,
       isCullingEnabled = !isCullingEnabled;
       env["isCullingEnabled"] = isCullingEnabled;
       break;
+    case GLFW_KEY_B:
+      isFrustumCullingEnabled = !isFrustumCullingEnabled;
+      env["isFrustumCullingEnabled"] = isFrustumCullingEnabled;
+      break;
+    case GLFW_KEY_G:
+      isGpuCullingEnabled = !isGpuCullingEnabled;
+      env["isGpuCullingEnabled"] = isGpuCullingEnabled;
+      break;
+    case GLFW_KEY_H:
+      isMeshletCullingEnabled = !isMeshletCullingEnabled;
+      env["isMeshletCullingEnabled"] = isMeshletCullingEnabled;
+      break;
+    case GLFW_KEY_T:
+      isVertexPullingEnabled = !isVertexPullingEnabled;
+      env["isVertexPullingEnabled"] = isVertexPullingEnabled;
+      break;
+    case GLFW_KEY_M:
+      isLodSelectionEnabled = !isLodSelectionEnabled;
+      env["isLodSelectionEnabled"] = isLodSelectionEnabled;
+      break;
     case GLFW_KEY_N:
       areNormalsEnabled = !areNormalsEnabled;
       env["areNormalsEnabled"] = areNormalsEnabled;
@@ -129,7 +196,20 @@ GLvoid mouseScroll(GLFWwindow* window, GLdouble x, GLdouble y)
 GLvoid initialiseEnvironment()
 {
   env = readProfile(profile);
+  profileEnv = env;
+
+  if (env["isTraceEnabled"]) {
+    tracer.enable();
+  }
 
+  applyEnvironment();
+}
+
+/**
+ * Set the scene properties from the environment.
+ */
+GLvoid applyEnvironment()
+{
   backgroundColour.r = env["backgroundColourRed"];
   backgroundColour.g = env["backgroundColourGreen"];
   backgroundColour.b = env["backgroundColourBlue"];
@@ -143,6 +223,13 @@ GLvoid initialiseEnvironment()
   isWireframeEnabled = env["isWireframeEnabled"];
   isOutlineEnabled = env["isOutlineEnabled"];
   isCullingEnabled = env["isCullingEnabled"];
+  isFrustumCullingEnabled = env["isFrustumCullingEnabled"];
+  isGpuCullingEnabled = env["isGpuCullingEnabled"];
+  featureInstanceCount = env["featureInstanceCount"];
+  isLodSelectionEnabled = env["isLodSelectionEnabled"];
+  lodPixelError = env["lodPixelError"];
+  isMeshletCullingEnabled = env["isMeshletCullingEnabled"];
+  isVertexPullingEnabled = env["isVertexPullingEnabled"];
   normalLength = env["normalLength"];
   outlineSize = env["outlineSize"] / 100.0f;
 
@@ -175,6 +262,10 @@ GLvoid initialiseCamera()
  */
 GLvoid initialiseModel()
 {
+  TraceZone zone("initialiseModel");
+  GLuint isProgramCacheEnabled = env["isProgramCacheEnabled"] &&
+                                 GLEW_ARB_get_program_binary;
+
   simpleShader = Shader("src/shaders/model.vert",
                         "src/shaders/model.frag",
                         "src/shaders/model.geom");
@@ -184,17 +275,277 @@ GLvoid initialiseModel()
   outlineShader = Shader("src/shaders/outline.vert",
                          "src/shaders/outline.frag",
                          "src/shaders/outline.geom");
-  simpleShader.load();
-  normalShader.load();
-  outlineShader.load();
+  simpleShader.isCacheEnabled = isProgramCacheEnabled;
+  normalShader.isCacheEnabled = isProgramCacheEnabled;
+  outlineShader.isCacheEnabled = isProgramCacheEnabled;
+  normalShader.isPositionStreamUsed = true;
+  outlineShader.isPositionStreamUsed = true;
+  normalShader.isLineDrawn = true;
+
+  // The same passes without geometry shaders. The wireframe and normal lines
+  // are drawn without an index buffer, fetching each index's vertex instead.
+  faceShader = Shader("src/shaders/model.vert", "src/shaders/model.frag");
+  wireframeShader = Shader("src/shaders/wireframe.vert",
+                           "src/shaders/model.frag");
+  normalLineShader = Shader("src/shaders/normalline.vert",
+                            "src/shaders/normal.frag");
+  wireframeShader.pulledPrimitive = GL_TRIANGLES;
+  normalLineShader.pulledPrimitive = GL_LINES;
+  normalLineShader.isLineDrawn = true;
+  faceShader.isCacheEnabled = isProgramCacheEnabled;
+  wireframeShader.isCacheEnabled = isProgramCacheEnabled;
+  normalLineShader.isCacheEnabled = isProgramCacheEnabled;
+
+  // Compute shaders, and so culling on the GPU, need OpenGL 4.3.
+  if (GLEW_VERSION_4_3) {
+    cullShader = Shader("src/shaders/cull.comp");
+    cullShader.isCacheEnabled = isProgramCacheEnabled;
+    renderQueue.cullShader = &cullShader;
+  }
 
-  featureModel = Model(featureModelPath);
-  lightModel = Model(lightModelPath);
+  // Let the driver compile the programs on its own threads while the models
+  // load, then wait for them once the models are ready.
+  if (GLEW_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+  } else if (GLEW_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+  }
+
+  simpleShader.submit();
+  normalShader.submit();
+  outlineShader.submit();
+  faceShader.submit();
+  wireframeShader.submit();
+  normalLineShader.submit();
+
+  if (renderQueue.cullShader) {
+    cullShader.submit();
+  }
+
+  // Create the uniform buffer shared by every shader program.
+  glGenBuffers(1, &frameUniformBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING,
+                   frameUniformBuffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  if (env["isGpuTimingEnabled"] || isBenchmarkEnabled) {
+    renderQueue.gpuTimer.initialise();
+  }
+
+  featureModel = createModel(featureModelPath);
+  lightModel = createModel(lightModelPath);
+  featureModel.isNormalizeEnabled = true;
 
   featureModel.load();
   lightModel.load();
 
-  featureModel.normalize(-1.0f, 1.0f);
+  simpleShader.finish();
+  normalShader.finish();
+  outlineShader.finish();
+  faceShader.finish();
+  wireframeShader.finish();
+  normalLineShader.finish();
+
+  if (renderQueue.cullShader) {
+    cullShader.finish();
+  }
+}
+
+/**
+ * Create a model of the given file with the import options from the
+ * environment.
+ */
+Model createModel(const std::string& filepath)
+{
+  Model model(filepath);
+
+  model.isCacheEnabled = env["isModelCacheEnabled"];
+  model.textureThreadCount = env["textureThreadCount"];
+  model.isObjLoaderEnabled = env["isObjLoaderEnabled"];
+  model.isOptimizationEnabled = env["isMeshOptimizationEnabled"];
+  model.isLodEnabled = env["isMeshLodEnabled"];
+  model.isMeshletEnabled = env["isMeshletEnabled"];
+  model.isDirectImportEnabled = env["isDirectImportEnabled"];
+  model.isGpuResidentEnabled = env["isGpuResidentEnabled"];
+  model.isPositionStreamEnabled = env["isPositionStreamEnabled"];
+  model.isTextureBakingEnabled = env["isTextureBakingEnabled"];
+  model.isTexturePackingEnabled = env["isTexturePackingEnabled"];
+
+  // BC4 is core, but BC1 and BC3 need S3TC.
+  model.isTextureCompressionEnabled = env["isTextureCompressionEnabled"] &&
+                                      GLEW_EXT_texture_compression_s3tc;
+
+  return model;
+}
+
+/**
+ * Watch the profile, shader files and models for changes, if hot reloading is
+ * enabled.
+ */
+GLvoid initialiseWatcher()
+{
+  Shader* shaders[] = { &simpleShader, &normalShader, &outlineShader,
+                        &faceShader, &wireframeShader, &normalLineShader };
+
+  if (!env["isHotReloadEnabled"] || !fileWatcher.initialise()) {
+    return;
+  }
+
+  fileWatcher.watch(profile);
+  fileWatcher.watch(featureModelPath);
+  fileWatcher.watch(lightModelPath);
+
+  for (GLuint i = 0; i < sizeof(shaders) / sizeof(Shader*); i++) {
+    std::vector<std::string> files = shaders[i]->files();
+
+    for (GLuint j = 0; j < files.size(); j++) {
+      fileWatcher.watch(files[j]);
+    }
+  }
+}
+
+/**
+ * Read the profile again and apply only the values that changed in the file
+ * since it was last read, so toggles changed with the keyboard are kept.
+ * Changed import options reload both models.
+ */
+GLvoid reloadProfile()
+{
+  std::map<std::string, GLfloat> fileEnv = readProfile(profile);
+  std::map<std::string, GLfloat>::const_iterator value;
+  GLuint changeCount = 0, areModelOptionsChanged = false;
+
+  for (value = fileEnv.begin(); value != fileEnv.end(); value++) {
+    if (profileEnv.count(value->first) &&
+        profileEnv[value->first] == value->second) {
+      continue;
+    }
+
+    env[value->first] = value->second;
+    changeCount++;
+    printf("Reloaded %s = %g\n", value->first.c_str(), value->second);
+
+    for (GLuint i = 0; i < sizeof(modelOptionNames) / sizeof(GLchar*); i++) {
+      if (value->first == modelOptionNames[i]) {
+        areModelOptionsChanged = true;
+      }
+    }
+  }
+
+  profileEnv = fileEnv;
+
+  if (!changeCount) {
+    return;
+  }
+
+  applyEnvironment();
+  camera.movementSpeed = env["cameraMovementSpeed"];
+  camera.turnSensitivity = env["cameraTurnSensitivity"];
+
+  if (camera.fov != env["cameraFov"]) {
+    camera.setFov(env["cameraFov"]);
+  }
+
+  if (areModelOptionsChanged) {
+    startModelReload(featureModel);
+    startModelReload(lightModel);
+  }
+}
+
+/**
+ * Import the given model's file again on a background thread, while the
+ * current model keeps rendering. The new model replaces it in
+ * finishModelReload once it is ready. Only one model is imported at a time,
+ * so a reload requested during another is queued, even for the model being
+ * imported, as its file may have changed after (or while) it was read.
+ */
+GLvoid startModelReload(Model& model)
+{
+  if (reloadTarget) {
+    queuedReloadTargets.insert(&model);
+    return;
+  }
+
+  reloadTarget = &model;
+  reloadedModel = createModel(&model == &featureModel ? featureModelPath
+                                                      : lightModelPath);
+  reloadedModel.isNormalizeEnabled = model.isNormalizeEnabled;
+
+  // Direct imports write into the buffers, which needs the context.
+  reloadedModel.isDirectImportEnabled = false;
+  isModelReloadReady = false;
+
+  modelReloadThread = std::thread([]() {
+    reloadedModel.readMeshes();
+    isModelReloadReady = true;
+  });
+}
+
+/**
+ * Upload a model imported by startModelReload once it is ready, and swap it
+ * with the model it replaces, then start the next queued reload.
+ */
+GLvoid finishModelReload()
+{
+  Model* nextTarget;
+
+  if (!reloadTarget || !isModelReloadReady) {
+    return;
+  }
+
+  TraceZone zone("finishModelReload");
+
+  modelReloadThread.join();
+  reloadedModel.uploadMeshes();
+  reloadTarget->unload();
+  *reloadTarget = std::move(reloadedModel);
+  reloadedModel = Model();
+  reloadTarget = NULL;
+
+  if (!queuedReloadTargets.empty()) {
+    nextTarget = *queuedReloadTargets.begin();
+    queuedReloadTargets.erase(queuedReloadTargets.begin());
+    startModelReload(*nextTarget);
+  }
+}
+
+/**
+ * Reload whatever the watched files that changed since the last frame affect:
+ * the environment for the profile, a single program for a shader file, and a
+ * background import for a model.
+ */
+GLvoid reloadChangedFiles()
+{
+  std::vector<std::string> changedFiles = fileWatcher.poll();
+  Shader* shaders[] = { &simpleShader, &normalShader, &outlineShader,
+                        &faceShader, &wireframeShader, &normalLineShader };
+
+  for (GLuint i = 0; i < changedFiles.size(); i++) {
+    const std::string& file = changedFiles[i];
+
+    if (file == profile) {
+      reloadProfile();
+    }
+
+    if (file == featureModelPath) {
+      startModelReload(featureModel);
+    }
+
+    if (file == lightModelPath) {
+      startModelReload(lightModel);
+    }
+
+    for (GLuint j = 0; j < sizeof(shaders) / sizeof(Shader*); j++) {
+      if (shaders[j]->usesFile(file) && shaders[j]->reload()) {
+        printf("Reloaded shader program: %s\n", file.c_str());
+      }
+    }
+  }
+
+  finishModelReload();
 }
 
 /**
@@ -218,122 +569,239 @@ GLvoid moveCamera()
   }
 }
 
+/**
+ * Upload the camera and light parameters shared by every shader program.
+ */
+GLvoid updateFrameUniforms()
+{
+  FrameUniforms frame;
+
+  frame.view = camera.view;
+  frame.projection = camera.projection;
+  frame.viewPosition = glm::vec4(camera.position, 1.0f);
+  frame.light.position = glm::vec4(lightPosition, isPointLightingEnabled);
+  frame.light.ambient = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
+  frame.light.diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+  frame.light.specular = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+  frame.light.constant = 1.0f;
+  frame.light.linear = 0.09f;
+  frame.light.quadratic = 0.032f;
+  frame.light.padding = 0.0f;
+
+  glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * Set the state of each render pass for the current toggles.
+ */
+GLvoid updatePassStates()
+{
+  PassState facesState = { true, isCullingEnabled, GL_ALWAYS, 0xFF };
+  PassState outlineState = { false, isCullingEnabled, GL_NOTEQUAL, 0x00 };
+
+  renderQueue.setPassState(FACES_PASS, facesState);
+  renderQueue.setPassState(NORMALS_PASS, facesState);
+  renderQueue.setPassState(OUTLINE_PASS, outlineState);
+  renderQueue.setPassState(LIGHT_PASS, facesState);
+}
+
+/**
+ * Scatter the feature model's instances on a square grid around the origin,
+ * tinted by their place on the grid, if their number has changed.
+ */
+GLvoid scatterInstances()
+{
+  GLuint side = ceil(sqrt((GLfloat)featureInstanceCount));
+  GLfloat offset = (side - 1) * INSTANCE_SPACING / 2.0f;
+  std::vector<glm::mat4> transforms;
+  std::vector<glm::vec4> tints;
+
+  if (featureModel.instanceCount() == featureInstanceCount) {
+    return;
+  }
+
+  transforms.resize(featureInstanceCount);
+  tints.resize(featureInstanceCount);
+
+  for (GLuint i = 0; i < featureInstanceCount; i++) {
+    GLfloat x = (GLfloat)(i % side) / std::max(side - 1, 1u);
+    GLfloat z = (GLfloat)(i / side) / std::max(side - 1, 1u);
+
+    transforms[i] = glm::translate(glm::mat4(1.0f), glm::vec3(
+                    (i % side) * INSTANCE_SPACING - offset, 0.0f,
+                    (i / side) * INSTANCE_SPACING - offset));
+    tints[i] = glm::vec4(0.6f + 0.4f * x, 0.8f, 0.6f + 0.4f * z, 1.0f);
+  }
+
+  featureModel.setInstances(transforms, tints);
+}
+
+/**
+ * Return the program that draws the given pass of the model. With vertex
+ * pulling, the faces and normals are drawn without geometry shaders (if the
+ * model's buffers fit in buffer textures), and the faces program only fetches
+ * its own vertices while the wireframe is shown.
+ */
+const Shader& passShader(GLuint pass, const Model& model)
+{
+  GLuint isPulled = isVertexPullingEnabled && model.canPullVertices();
+
+  if (pass == OUTLINE_PASS) {
+    return outlineShader;
+  } else if (pass == NORMALS_PASS) {
+    return isPulled ? normalLineShader : normalShader;
+  } else if (!isPulled) {
+    return simpleShader;
+  }
+
+  return (isWireframeEnabled || !areFacesEnabled) ? wireframeShader
+                                                  : faceShader;
+}
+
+/**
+ * Queue a pass of the feature model, as one instanced draw per mesh of all
+ * its instances if there are any.
+ */
+GLvoid submitFeatureModel(GLuint pass, const Shader& shader,
+                          const glm::mat4& transform,
+                          const glm::vec4* frustumPlanes)
+{
+  if (featureInstanceCount) {
+    featureModel.submitInstanced(renderQueue, pass, shader, transform);
+  } else {
+    featureModel.submit(renderQueue, pass, shader, transform, frustumPlanes);
+  }
+}
+
+/**
+ * Queue every pass of the feature model and the light model, then draw them
+ * sorted by state.
+ */
 GLvoid drawModel()
 {
   using namespace glm;
 
-  mat4 model;
-
-  GLuint modelLoc, viewLoc, projectionLoc, viewPosLoc;
-  GLuint facesLoc, wireframeLoc, wireframeColourLoc, normalLengthLoc;
-  GLuint matShineLoc, outlineSizeLoc, outlineColourLoc;
-  GLuint lightPositionLoc, lightAmbientLoc, lightDiffuseLoc, lightSpecularLoc;
-
-  // Draw the feature model.
-  simpleShader.use();
-
-  viewPosLoc  = glGetUniformLocation(simpleShader.id, "viewPosition");
-  modelLoc      = glGetUniformLocation(simpleShader.id, "model");
-  viewLoc       = glGetUniformLocation(simpleShader.id, "view");
-  projectionLoc = glGetUniformLocation(simpleShader.id, "projection");
-
-  glUniform4f(viewPosLoc, camera.position.x,
-              camera.position.y, camera.position.z, 1.0f);
-  glUniformMatrix4fv(modelLoc, 1, GL_FALSE, value_ptr(model));
-  glUniformMatrix4fv(viewLoc, 1, GL_FALSE, value_ptr(camera.view));
-  glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, value_ptr(camera.projection));
-
-  // Material uniforms
-  matShineLoc    = glGetUniformLocation(simpleShader.id, "material.shininess"); 
-  glUniform1f(matShineLoc, shineValue);
-
-  // Light uniforms
-  lightPositionLoc = glGetUniformLocation(simpleShader.id, "light.position");
-  lightAmbientLoc  = glGetUniformLocation(simpleShader.id, "light.ambient");
-  lightDiffuseLoc  = glGetUniformLocation(simpleShader.id, "light.diffuse");
-  lightSpecularLoc = glGetUniformLocation(simpleShader.id, "light.specular");
-
-  glUniform1f(glGetUniformLocation(simpleShader.id, "light.constant"),  1.0f);
-  glUniform1f(glGetUniformLocation(simpleShader.id, "light.linear"),    0.09f);
-  glUniform1f(glGetUniformLocation(simpleShader.id, "light.quadratic"), 0.032f);
-
-  glUniform4f(lightPositionLoc, lightPosition.x,
-              lightPosition.y, lightPosition.z, isPointLightingEnabled);
-  glUniform3f(lightAmbientLoc,  0.3f, 0.3f, 0.3f);
-  glUniform3f(lightDiffuseLoc, 1.0f, 1.0f, 1.0f);
-  glUniform3f(lightSpecularLoc, 1.0f, 1.0f, 1.0f);
-
-  facesLoc = glGetUniformLocation(simpleShader.id, "areFacesEnabled");
-  wireframeLoc = glGetUniformLocation(simpleShader.id, "isWireframeEnabled");
-  wireframeColourLoc = glGetUniformLocation(simpleShader.id, "wireframeColour");
-  glUniform1f(facesLoc, areFacesEnabled);
-  glUniform1f(wireframeLoc, isWireframeEnabled);
-  glUniform4f(wireframeColourLoc, wireframeColour.r, wireframeColour.g,
-                                  wireframeColour.b, wireframeColour.a);
-  
-  if (isOutlineEnabled) {
-    glStencilFunc(GL_ALWAYS, 1, 0xFF);
-    glStencilMask(0xFF);
-  }
-  
-  featureModel.draw(simpleShader, isCullingEnabled);
+  mat4 model, lightTransform;
+  const vec4* frustumPlanes = isFrustumCullingEnabled ?
+                              camera.frustumPlanes : NULL;
+  Shader* faceShaders[] = { &simpleShader, &faceShader, &wireframeShader };
+  Shader* normalShaders[] = { &normalShader, &normalLineShader };
 
-  if (areNormalsEnabled) {
-    normalShader.use();
+  updateFrameUniforms();
+  updatePassStates();
+  renderQueue.isGpuCullingEnabled = isGpuCullingEnabled;
+  renderQueue.lodPixelError = lodPixelError;
+  renderQueue.isMeshletCullingEnabled = isMeshletCullingEnabled;
 
-    modelLoc      = glGetUniformLocation(normalShader.id, "model");
-    viewLoc       = glGetUniformLocation(normalShader.id, "view");
-    projectionLoc = glGetUniformLocation(normalShader.id, "projection");
+  // The pixels covered by one unit at a distance of one.
+  renderQueue.lodScale = isLodSelectionEnabled ? frameHeight /
+                         (2.0f * tan(radians(camera.fov) / 2.0f)) : 0.0f;
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, value_ptr(camera.view));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE,value_ptr(camera.projection));
+  if (featureInstanceCount) {
+    scatterInstances();
+  }
 
-    normalLengthLoc = glGetUniformLocation(normalShader.id, "normalLength");
-    glUniform1f(normalLengthLoc, normalLength);
-    
-    featureModel.draw(normalShader, isCullingEnabled);
+  // Set the uniforms that are the same for every draw of each program.
+  for (GLuint i = 0; i < 3; i++) {
+    faceShaders[i]->use();
+    glUniform1f(faceShaders[i]->uniform("material.shininess"), shineValue);
+    glUniform1f(faceShaders[i]->uniform("areFacesEnabled"), areFacesEnabled);
+    glUniform1f(faceShaders[i]->uniform("isWireframeEnabled"),
+                isWireframeEnabled);
+    glUniform4f(faceShaders[i]->uniform("wireframeColour"),
+                wireframeColour.r, wireframeColour.g,
+                wireframeColour.b, wireframeColour.a);
+  }
+
+  for (GLuint i = 0; areNormalsEnabled && i < 2; i++) {
+    normalShaders[i]->use();
+    glUniform1f(normalShaders[i]->uniform("normalLength"), normalLength);
   }
 
   if (isOutlineEnabled) {
-    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-    glStencilMask(0x00);
-    glDisable(GL_DEPTH_TEST);
     outlineShader.use();
+    glUniform1f(outlineShader.uniform("outlineSize"), outlineSize);
+    glUniform4f(outlineShader.uniform("outlineColour"),
+                outlineColour.r, outlineColour.g,
+                outlineColour.b, outlineColour.a);
+  }
+
+  renderQueue.clear(camera.view);
+
+  // Queue the feature model.
+  submitFeatureModel(FACES_PASS, passShader(FACES_PASS, featureModel), model,
+                     frustumPlanes);
+
+  if (areNormalsEnabled) {
+    submitFeatureModel(NORMALS_PASS, passShader(NORMALS_PASS, featureModel),
+                       model, frustumPlanes);
+  }
 
-    modelLoc      = glGetUniformLocation(outlineShader.id, "model");
-    viewLoc       = glGetUniformLocation(outlineShader.id, "view");
-    projectionLoc = glGetUniformLocation(outlineShader.id, "projection");
+  if (isOutlineEnabled) {
+    submitFeatureModel(OUTLINE_PASS, passShader(OUTLINE_PASS, featureModel),
+                       model, frustumPlanes);
+  }
 
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, value_ptr(camera.view));
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE,value_ptr(camera.projection));
+  // Queue the light model.
+  lightTransform = translate(lightTransform, vec3(lightPosition.x,
+                             lightPosition.y, lightPosition.z));
+  lightTransform = scale(lightTransform, vec3(0.1f));
 
-    outlineSizeLoc = glGetUniformLocation(outlineShader.id, "outlineSize");
-    glUniform1f(outlineSizeLoc, outlineSize);
+  lightModel.submit(renderQueue, LIGHT_PASS,
+                    passShader(LIGHT_PASS, lightModel), lightTransform,
+                    frustumPlanes);
+
+  renderQueue.execute();
+}
 
-    outlineColourLoc = glGetUniformLocation(outlineShader.id, "outlineColour");
-    glUniform4f(outlineColourLoc, outlineColour.r, outlineColour.g,
-                                  outlineColour.b, outlineColour.a);
-    
-    featureModel.draw(outlineShader, isCullingEnabled);
+/**
+ * Show the number of visible and culled mesh draws, and of culled meshlets,
+ * in the window title when they change.
+ */
+GLvoid updateWindowTitle()
+{
+  static GLuint visibleMeshCount = 0, culledMeshCount = 0;
+  static GLuint culledMeshletCount = 0;
+  GLchar title[128];
 
-    glStencilMask(0xFF);
-    glEnable(GL_DEPTH_TEST);
+  if (renderQueue.statistics.visibleMeshCount == visibleMeshCount &&
+      renderQueue.statistics.culledMeshCount == culledMeshCount &&
+      renderQueue.statistics.culledMeshletCount == culledMeshletCount) {
+    return;
   }
 
-  // Draw the light model.
-  simpleShader.use();
+  visibleMeshCount = renderQueue.statistics.visibleMeshCount;
+  culledMeshCount = renderQueue.statistics.culledMeshCount;
+  culledMeshletCount = renderQueue.statistics.culledMeshletCount;
+
+  snprintf(title, sizeof(title),
+           "Model Loading (%u visible, %u culled, %u meshlets culled)",
+           visibleMeshCount, culledMeshCount, culledMeshletCount);
+  glfwSetWindowTitle(window, title);
+}
+
+/**
+ * Print the rolling average GPU time of each render pass once a second, if
+ * GPU timing is enabled, and how many results were dropped so far.
+ */
+GLvoid printGpuTimes()
+{
+  if (!renderQueue.gpuTimer.isEnabled() ||
+      timer.currentTime - lastGpuTimePrintTime < 1.0f) {
+    return;
+  }
 
-  model = mat4();
-  model = translate(model, vec3(lightPosition.x,
-                    lightPosition.y, lightPosition.z));
-  model = scale(model, vec3(0.1f));
+  lastGpuTimePrintTime = timer.currentTime;
+  printf("GPU time (ms):");
 
-  modelLoc = glGetUniformLocation(simpleShader.id, "model");
-  glUniformMatrix4fv(modelLoc, 1, GL_FALSE, value_ptr(model));
+  for (GLuint i = 0; i < RENDER_PASS_COUNT; i++) {
+    printf(" %s %.3f", renderPassNames[i],
+           renderQueue.gpuTimer.averageTime(i));
+  }
 
-  lightModel.draw(simpleShader, isCullingEnabled);
+  printf(" (%u dropped)\n", renderQueue.gpuTimer.droppedCount());
 }
 
 /**
@@ -380,22 +848,186 @@ GLvoid runMainLoop()
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
     // Draw functions.
+    reloadChangedFiles();
     drawModel();
+    updateWindowTitle();
+    printGpuTimes();
 
     glfwSwapBuffers(window);
   }
 }
 
 /**
- * Initialise the graphics libraries and window.
+ * Move the camera along the benchmark path, at the given fraction of the way
+ * round it. The camera circles the (normalized) feature model while moving
+ * in and out, so parts of the model leave the view near the closest points.
+ */
+GLvoid updateBenchmarkCamera(GLfloat progress)
+{
+  GLfloat angle = 2.0f * M_PI * progress;
+  GLfloat distance = 1.5f + cos(2.0f * angle);
+  glm::vec3 front;
+
+  camera.position = glm::vec3(distance * cos(angle), 0.5f,
+                              distance * sin(angle));
+  front = glm::normalize(-camera.position);
+  camera.yaw = glm::degrees(atan2(front.z, front.x));
+  camera.setPitch(glm::degrees(asin(front.y)));
+  camera.updateOrientation(0.0f, 0.0f);
+}
+
+/**
+ * Render every benchmark scenario along the scripted camera path and write
+ * the frame-time percentiles, CPU submit times and triangle rates as JSON to
+ * the benchmark output file. Each frame is
+ * finished before it is timed, so the times include the GPU's work.
+ */
+GLvoid runBenchmark()
+{
+  GLuint frameCount = std::max((GLuint)env["benchmarkFrameCount"], 1u);
+  GLuint warmupFrameCount = env["benchmarkWarmupFrameCount"];
+  GLuint instanceCount = env["benchmarkInstanceCount"];
+  GLuint scenarioCount = sizeof(benchmarkScenarios) /
+                         sizeof(BenchmarkScenario);
+  FILE* output = fopen(benchmarkOutputPath.c_str(), "w");
+
+  if (!output) {
+    fprintf(stderr, "\nBenchmark error in file: %s\n%s\n",
+            benchmarkOutputPath.c_str(), strerror(errno));
+
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(output, "{\n");
+  fprintf(output, "  \"renderer\": \"%s\",\n",
+          escapeJson((const GLchar*)glGetString(GL_RENDERER)).c_str());
+  fprintf(output, "  \"featureModel\": \"%s\",\n",
+          escapeJson(featureModelPath).c_str());
+  fprintf(output, "  \"width\": %d,\n  \"height\": %d,\n",
+          frameWidth, frameHeight);
+  fprintf(output, "  \"frames\": %u,\n  \"scenarios\": [\n", frameCount);
+
+  for (GLuint i = 0; i < scenarioCount; i++) {
+    const BenchmarkScenario& scenario = benchmarkScenarios[i];
+    std::vector<GLdouble> frameTimes, submitTimes;
+    GLdouble totalTime = 0.0, triangleCount = 0.0;
+
+    areFacesEnabled = scenario.areFacesEnabled;
+    isWireframeEnabled = scenario.isWireframeEnabled;
+    areNormalsEnabled = scenario.areNormalsEnabled;
+    isOutlineEnabled = scenario.isOutlineEnabled;
+    isCullingEnabled = scenario.isCullingEnabled;
+    featureInstanceCount = scenario.isInstancingEnabled ? instanceCount : 0;
+    isVertexPullingEnabled = scenario.isVertexPullingEnabled;
+
+    for (GLuint j = 0; j < warmupFrameCount + frameCount; j++) {
+      GLdouble startTime, submitTime, endTime;
+
+      updateBenchmarkCamera((GLfloat)j / (warmupFrameCount + frameCount));
+
+      startTime = currentTime();
+      glClearColor(backgroundColour.r, backgroundColour.g,
+                   backgroundColour.b, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+              GL_STENCIL_BUFFER_BIT);
+      drawModel();
+      submitTime = currentTime();
+      glFinish();
+      endTime = currentTime();
+
+      if (j < warmupFrameCount) {
+        continue;
+      } else if (j == warmupFrameCount) {
+        renderQueue.gpuTimer.reset();
+      }
+
+      frameTimes.push_back((endTime - startTime) * 1000.0);
+      submitTimes.push_back((submitTime - startTime) * 1000.0);
+      totalTime += endTime - startTime;
+      triangleCount += renderQueue.statistics.triangleCount;
+    }
+
+    // Read back the last frame's GPU times, which are finished.
+    renderQueue.gpuTimer.endFrame();
+
+    fprintf(output, "    {\n      \"name\": \"%s\",\n", scenario.name);
+    fprintf(output, "      \"frameTimeMs\": { \"p50\": %.3f, "
+            "\"p95\": %.3f, \"p99\": %.3f },\n",
+            percentile(frameTimes, 50.0), percentile(frameTimes, 95.0),
+            percentile(frameTimes, 99.0));
+    fprintf(output, "      \"submitTimeMs\": { \"p50\": %.3f, "
+            "\"p95\": %.3f, \"p99\": %.3f },\n",
+            percentile(submitTimes, 50.0), percentile(submitTimes, 95.0),
+            percentile(submitTimes, 99.0));
+    fprintf(output, "      \"gpuTimeMs\": {");
+
+    for (GLuint j = 0; j < RENDER_PASS_COUNT; j++) {
+      fprintf(output, " \"%s\": %.3f%s", renderPassNames[j],
+              renderQueue.gpuTimer.meanTime(j),
+              (j + 1 < RENDER_PASS_COUNT) ? "," : " },\n");
+    }
+
+    fprintf(output, "      \"gpuSamplesDropped\": %u,\n",
+            renderQueue.gpuTimer.droppedCount());
+
+    fprintf(output, "      \"trianglesPerSecond\": %.0f\n    }%s\n",
+            triangleCount / totalTime, (i + 1 < scenarioCount) ? "," : "");
+  }
+
+  fprintf(output, "  ]\n}\n");
+
+  fclose(output);
+}
+
+/**
+ * Initialise the graphics libraries and window, or an offscreen context when
+ * benchmarking.
  */
 GLvoid initialiseGraphics(GLint argc, GLchar* argv[])
+{
+  TraceZone zone("initialiseGraphics");
+
+  if (isBenchmarkEnabled) {
+    frameWidth = DEFAULT_WINDOW_WIDTH;
+    frameHeight = DEFAULT_WINDOW_HEIGHT;
+
+    if (!headlessContext.create(frameWidth, frameHeight)) {
+      fprintf(stderr, "\nHeadless context error\n%s\n",
+              "Failed to create an offscreen OpenGL 3.3 context with EGL");
+
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    initialiseWindow();
+  }
+
+  // Define the viewport dimensions.
+  aspectRatio = (GLfloat)frameWidth / (GLfloat)frameHeight;
+  glViewport(0, 0, frameWidth, frameHeight);
+
+  // Set extra options.
+  glEnable(GL_DEPTH_TEST);
+
+  glEnable(GL_STENCIL_TEST);
+  glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+/**
+ * Initialise GLFW and the window, and make its context current.
+ */
+GLvoid initialiseWindow()
 {
   GLint majorVersion, minorVersion, revision;
   GLuint isFullscreen = env["isFullScreenEnabled"];
 
   // Initialise GLFW.
-  glfwInit();
+  {
+    TraceZone zone("glfwInit");
+    glfwInit();
+  }
 
   // Initialise the window and force the use of modern OpenGL (v. >= 3.0).
   glfwGetVersion(&majorVersion, &minorVersion, &revision);
@@ -415,9 +1047,12 @@ GLvoid initialiseGraphics(GLint argc, GLchar* argv[])
     width = videoMode->width;
     height = videoMode->height;
   }
-  window = glfwCreateWindow(width, height, "Model Loading", monitor, nullptr);
-
-  glfwMakeContextCurrent(window);
+  {
+    TraceZone zone("glfwCreateWindow");
+    window = glfwCreateWindow(width, height, "Model Loading", monitor,
+                              nullptr);
+    glfwMakeContextCurrent(window);
+  }
 
   // Enable keyboard and mouse input.
   glfwSetKeyCallback(window, keyboard);
@@ -425,23 +1060,14 @@ GLvoid initialiseGraphics(GLint argc, GLchar* argv[])
   glfwSetScrollCallback(window, mouseScroll);
 
   // Initialise GLEW.
-  glewExperimental = GL_TRUE;
-  glewInit();
+  {
+    TraceZone zone("glewInit");
+    glewExperimental = GL_TRUE;
+    glewInit();
+  }
 
-  // Define the viewport dimensions.
   glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
-  aspectRatio = (GLfloat)frameWidth / (GLfloat)frameHeight;
-  glViewport(0, 0, frameWidth, frameHeight);
-
-  // Set extra options.
   glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-  glEnable(GL_DEPTH_TEST);
-
-  glEnable(GL_STENCIL_TEST);
-  glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
-  
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 /**
@@ -453,11 +1079,27 @@ GLvoid terminateGraphics()
   simpleShader.unload();
   normalShader.unload();
   outlineShader.unload();
+  faceShader.unload();
+  wireframeShader.unload();
+  normalLineShader.unload();
+  cullShader.unload();
+  glDeleteBuffers(1, &frameUniformBuffer);
+  renderQueue.gpuTimer.destroy();
+
+  if (modelReloadThread.joinable()) {
+    modelReloadThread.join();
+  }
 
+  fileWatcher.destroy();
+  reloadedModel.unload();
   featureModel.unload();
   lightModel.unload();
 
-  glfwTerminate();
+  if (isBenchmarkEnabled) {
+    headlessContext.destroy();
+  } else {
+    glfwTerminate();
+  }
 }
 
 /**
@@ -473,12 +1115,25 @@ GLint main(GLint argc, GLchar* argv[])
 
   if (argc < 3) {
     printf("To run, provide a feature model path and light model path, e.g:\n./build.sh -x models/nanosuit/nanosuit.obj models/icosphere/icosphere.obj\n");
+    printf("Add --benchmark output.json to run the headless benchmark.\n");
     return -1;
   } else {
     featureModelPath = std::string(argv[1]);
     lightModelPath = std::string(argv[2]);
   }
 
+  // The report needs its own file, as loading prints to stdout.
+  if (argc >= 4 && std::string(argv[3]) == "--benchmark") {
+    if (argc < 5) {
+      fprintf(stderr, "\nBenchmark error: %s\n",
+              "--benchmark needs an output file");
+      return -1;
+    }
+
+    isBenchmarkEnabled = true;
+    benchmarkOutputPath = argv[4];
+  }
+
   // Initialise the envorinment properties.
   initialiseEnvironment();
 
@@ -489,8 +1144,18 @@ GLint main(GLint argc, GLchar* argv[])
   initialiseCamera();
   initialiseModel();
 
-  // Run the graphics loop.
-  runMainLoop();
+  // Write the trace of the startup phases.
+  if (tracer.isEnabled()) {
+    tracer.write(TRACE_FILEPATH);
+  }
+
+  // Run the graphics loop, or the benchmark.
+  if (isBenchmarkEnabled) {
+    runBenchmark();
+  } else {
+    initialiseWatcher();
+    runMainLoop();
+  }
 
   // Close the application gracefully.
   terminateGraphics();
@@ -8,31 +8,76 @@
 // System headers
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <errno.h>
+#include <set>
+#include <string.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "helpers.hpp"
 #include "camera.cpp"
+#include "headless.cpp"
 #include "model.cpp"
 #include "shader.cpp"
 #include "timer.hpp"
+#include "watcher.cpp"
 
 #define true  1
 #define false 0
 #define DEFAULT_WINDOW_WIDTH  1200
 #define DEFAULT_WINDOW_HEIGHT 675
 
+// The distance between the feature model instances scattered on a grid.
+#define INSTANCE_SPACING 1.0f
+
+// Render passes, drawn in this order.
+enum RenderPass {
+  FACES_PASS, NORMALS_PASS, OUTLINE_PASS, LIGHT_PASS, RENDER_PASS_COUNT
+};
+
+// The toggles used for one run of the camera path by the benchmark.
+struct BenchmarkScenario {
+  const GLchar* name;
+  GLuint areFacesEnabled;
+  GLuint isWireframeEnabled;
+  GLuint areNormalsEnabled;
+  GLuint isOutlineEnabled;
+  GLuint isCullingEnabled;
+  GLuint isInstancingEnabled;
+  GLuint isVertexPullingEnabled;
+};
+
 GLvoid initialiseAll();
 GLvoid keyboard(GLFWwindow* window, GLint key, GLint scancode,
                 GLint action, GLint mode);
 GLvoid mouseMovement(GLFWwindow* window, GLdouble x, GLdouble y);
 GLvoid mouseScroll(GLFWwindow* window, GLdouble x, GLdouble y);
 GLvoid initialiseEnvironment();
+GLvoid applyEnvironment();
 GLvoid initialiseCamera();
 GLvoid initialiseModel();
+Model createModel(const std::string& filepath);
+GLvoid initialiseWatcher();
+GLvoid reloadProfile();
+GLvoid startModelReload(Model& model);
+GLvoid finishModelReload();
+GLvoid reloadChangedFiles();
 GLvoid moveCamera();
+GLvoid updateFrameUniforms();
+GLvoid updatePassStates();
+GLvoid scatterInstances();
+const Shader& passShader(GLuint pass, const Model& model);
+GLvoid submitFeatureModel(GLuint pass, const Shader& shader,
+                          const glm::mat4& transform,
+                          const glm::vec4* frustumPlanes);
+GLvoid drawModel();
+GLvoid updateWindowTitle();
+GLvoid printGpuTimes();
 GLvoid runMainLoop();
+GLvoid updateBenchmarkCamera(GLfloat progress);
+GLvoid runBenchmark();
 GLvoid initialiseGraphics(GLint argc, GLchar* argv[]);
+GLvoid initialiseWindow();
 GLvoid terminateGraphics();
 GLint main(GLint argc, GLchar* argv[]);
\ No newline at end of file
@@ -2,6 +2,8 @@
  * [Program description]
  */
 
+#include <limits>
+
 #include "mesh.hpp"
 
 /**
@@ -11,83 +13,137 @@ Mesh::Mesh(std::vector<Vertex> meshVertices,
            std::vector<GLuint> meshIndices,
            std::vector<Texture> meshTextures)
 {
-  vertices = meshVertices;
-  indices = meshIndices;
-  textures = meshTextures;
+  vertices = std::move(meshVertices);
+  indices = std::move(meshIndices);
+  textures = std::move(meshTextures);
+  baseVertex = 0;
+  vertexCount = vertices.size();
+  firstIndex = 0;
+  indexCount = indices.size();
+  vertexTexture = indexTexture = 0;
+  bounds.min = bounds.max = bounds.center = glm::vec3(0.0f);
+  bounds.radius = 0.0f;
 }
 
-GLvoid Mesh::load()
+/**
+ * Bind the mesh texture(s) to their material's texture units and return the
+ * number of textures bound. If given, boundTextures holds the texture bound
+ * to each unit, and units that already have the right texture are skipped.
+ */
+GLuint Mesh::bindTextures(GLuint* boundTextures) const
 {
-  glGenVertexArrays(1, &vao);
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &ebo);
-
-  glBindVertexArray(vao);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), 
-               &vertices[0], GL_STATIC_DRAW);  
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), 
-               &indices[0], GL_STATIC_DRAW);
-
-  // Vertex positions
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (GLvoid*)offsetof(Vertex, position));
-  // Normals
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (GLvoid*)offsetof(Vertex, normal));
-  // Texture coordinates
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (GLvoid*)offsetof(Vertex, textureCoords));
-
-  glBindVertexArray(0);
+  GLuint diffuseNo = 0, specularNo = 0, bindCount = 0;
+  GLint unit;
+
+  for (GLuint i = 0; i < textures.size(); i++) {
+    std::string name = textures[i].type;
+    unit = textureUnit(name, (name == "diffuse") ? ++diffuseNo : ++specularNo);
+
+    if (unit < 0 || (boundTextures && boundTextures[unit] == textures[i].id)) {
+      continue;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textures[i].id);
+    bindCount++;
+
+    if (boundTextures) {
+      boundTextures[unit] = textures[i].id;
+    }
+  }
+
+  if (bindCount) {
+    glActiveTexture(GL_TEXTURE0);
+  }
+
+  return bindCount;
 }
 
-GLvoid Mesh::unload()
+/**
+ * Return the array layers of the mesh's first diffuse and specular textures,
+ * for the material layers vertex attribute.
+ */
+glm::ivec2 Mesh::textureLayers() const
 {
-  glBindVertexArray(vao);
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
-  glDisableVertexAttribArray(2);
-  glBindVertexArray(0);
-
-  glDeleteVertexArrays(1, &vao);
-  glDeleteBuffers(1, &vbo);
-  glDeleteBuffers(1, &ebo);
+  glm::ivec2 layers(0);
+  GLuint isDiffuseFound = false, isSpecularFound = false;
+
+  for (GLuint i = 0; i < textures.size(); i++) {
+    if (textures[i].type == "diffuse" && !isDiffuseFound) {
+      layers.x = textures[i].layer;
+      isDiffuseFound = true;
+    } else if (textures[i].type == "specular" && !isSpecularFound) {
+      layers.y = textures[i].layer;
+      isSpecularFound = true;
+    }
+  }
+
+  return layers;
 }
 
-GLvoid Mesh::reload()
+/**
+ * Return the given level of detail, where level 0 is the full mesh.
+ */
+MeshLod Mesh::lod(GLuint level) const
 {
-  unload();
-  load();
+  MeshLod fullLod = { 0, indexCount, 0.0f };
+
+  return (level > 0 && level <= lods.size()) ? lods[level - 1] : fullLod;
 }
 
-GLvoid Mesh::draw(Shader shader)
+/**
+ * Return the coarsest level of detail whose error is at most the given number
+ * of pixels, for a mesh whose bounding radius covers the given pixels.
+ */
+GLuint Mesh::selectLod(GLfloat radiusPixels, GLfloat maxPixelError) const
 {
-  GLuint diffuseNo = 0, specularNo = 0;
+  for (GLuint level = lods.size(); level > 0; level--) {
+    if (lods[level - 1].error * radiusPixels <= maxPixelError) {
+      return level;
+    }
+  }
 
-  // Bind the mesh texture(s).
-  for (GLuint i = 0; i < textures.size(); i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
+  return 0;
+}
 
-    std::string name = textures[i].type;
-    std::string number = (name == "diffuse") ?
-                         std::to_string(diffuseNo++) :
-                         std::to_string(specularNo++);
+/**
+ * Draw the given number of instances of a level of detail of the mesh's range
+ * of the bound buffers.
+ */
+GLvoid Mesh::drawElements(GLuint instanceCount, GLuint level) const
+{
+  MeshLod range = lod(level);
+  GLvoid* offset = (GLvoid*)((firstIndex + range.firstIndex) *
+                             sizeof(GLuint));
+
+  if (instanceCount == 1) {
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                             offset, baseVertex);
+    return;
+  }
 
-    glUniform1i(glGetUniformLocation(shader.id,
-                ("material." + name + number).c_str()), i); 
-    glBindTexture(GL_TEXTURE_2D, textures[i].id);
+  glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount,
+                                    GL_UNSIGNED_INT, offset, instanceCount,
+                                    baseVertex);
+}
+
+/**
+ * Calculate the mesh's bounding box and the bounding sphere around the box.
+ */
+GLvoid Mesh::calculateBounds()
+{
+  if (vertices.empty()) {
+    bounds.min = bounds.max = bounds.center = glm::vec3(0.0f);
+    bounds.radius = 0.0f;
+    return;
   }
-  glActiveTexture(GL_TEXTURE0);
 
-  // Draw the mesh.
-  glBindVertexArray(vao);
-  glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
-}
\ No newline at end of file
+  bounds.min = glm::vec3(std::numeric_limits<GLfloat>::max());
+  bounds.max = glm::vec3(-std::numeric_limits<GLfloat>::max());
+
+  findPositionBounds(&vertices[0].position.x, vertices.size(),
+                     sizeof(Vertex) / sizeof(GLfloat), bounds.min, bounds.max);
+
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  bounds.radius = glm::length(bounds.max - bounds.center);
+}
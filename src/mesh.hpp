@@ -7,6 +7,8 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include "bounds.hpp"
+#include "kernels.hpp"
 #include "shader.hpp"
 
 struct Vertex {
@@ -15,29 +17,112 @@ struct Vertex {
   glm::vec2 textureCoords;
 };
 
+/**
+ * A cluster of a mesh's triangles, which are a range of the mesh's indices
+ * starting at firstIndex (relative to the mesh's first index). The normal
+ * cone, an axis and the sine of its half angle, bounds the normals of the
+ * triangles, so the whole cluster can be culled when it faces away.
+ */
+struct Meshlet {
+  Bounds bounds;
+  glm::vec3 coneAxis;
+  GLfloat coneCutoff;
+  GLuint firstIndex;
+  GLuint indexCount;
+};
+
+/**
+ * The per-instance attributes of an instanced draw.
+ */
+struct Instance {
+  glm::mat4 transform;
+  glm::vec4 tint;
+};
+
+/**
+ * A material texture. Every texture is a layer of a 2D array texture, which
+ * may hold the model's other textures of the same size and format.
+ */
 struct Texture {
   GLuint id;
+  GLuint layer;
   std::string type;
   aiString filepath;
 };
 
+#define MAX_TEXTURES_PER_TYPE 4
+#define MAX_MESH_LODS         3
+
+/**
+ * A simplified level of detail of a mesh. Its indices follow the mesh's own
+ * in the index buffer, and its first index is relative to the mesh's. The
+ * error is the furthest the level strays from the full mesh, relative to the
+ * mesh's bounding radius.
+ */
+struct MeshLod {
+  GLuint firstIndex;
+  GLuint indexCount;
+  GLfloat error;
+};
+
+// The vertex attribute with the array layers of a draw's material textures.
+#define MATERIAL_LAYERS_ATTRIBUTE 3
+
+// The vertex attributes of an instance's transform (one per column) and tint.
+#define INSTANCE_TRANSFORM_ATTRIBUTE 4
+#define INSTANCE_TINT_ATTRIBUTE      8
+
+// The texture units of the buffer textures that programs fetch their own
+// vertices from, after the material textures' units.
+#define VERTEX_BUFFER_UNIT (2 * MAX_TEXTURES_PER_TYPE)
+#define INDEX_BUFFER_UNIT  (VERTEX_BUFFER_UNIT + 1)
+
+/**
+ * Return the texture unit that the given material texture is bound to, or -1
+ * if it has none. Each texture type has its own range of units, so shaders
+ * can bind their material samplers once when they are loaded.
+ */
+GLint textureUnit(std::string type, GLuint number)
+{
+  if (number == 0 || number > MAX_TEXTURES_PER_TYPE) {
+    return -1;
+  }
+
+  if (type == "diffuse") {
+    return number - 1;
+  } else if (type == "specular") {
+    return MAX_TEXTURES_PER_TYPE + number - 1;
+  }
+
+  return -1;
+}
+
 class Mesh
 {
   public:
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
+    std::vector<GLuint> lodIndices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    GLuint baseVertex;
+    GLuint vertexCount;
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLuint vertexTexture;
+    GLuint indexTexture;
+    Bounds bounds;
 
-    Mesh(std::vector<Vertex> meshVertices,
-         std::vector<GLuint> meshIndices,
-         std::vector<Texture> meshTextures);
-    GLvoid load();
-    GLvoid unload();
-    GLvoid reload();
-    GLvoid draw(Shader shader);
-
-  private:
-    GLuint vao, vbo, ebo;
+    Mesh(std::vector<Vertex> meshVertices = std::vector<Vertex>(),
+         std::vector<GLuint> meshIndices = std::vector<GLuint>(),
+         std::vector<Texture> meshTextures = std::vector<Texture>());
+    GLuint bindTextures(GLuint* boundTextures) const;
+    glm::ivec2 textureLayers() const;
+    MeshLod lod(GLuint level) const;
+    GLuint selectLod(GLfloat radiusPixels, GLfloat maxPixelError) const;
+    GLvoid drawElements(GLuint instanceCount = 1, GLuint level = 0) const;
+    GLvoid calculateBounds();
 };
   
 #endif
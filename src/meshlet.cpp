@@ -0,0 +1,227 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+
+#include "meshlet.hpp"
+
+#define NO_INDEX 0xffffffff
+
+/**
+ * Return whether every triangle of the meshlet faces away from the given
+ * position (in the mesh's space). The cone is moved back from the bounding
+ * sphere's center so that it covers the whole sphere.
+ */
+GLuint isMeshletBackFacing(const Meshlet& meshlet, glm::vec3 viewPosition)
+{
+  glm::vec3 direction = meshlet.bounds.center - viewPosition;
+
+  return glm::dot(direction, meshlet.coneAxis) >=
+         meshlet.coneCutoff * glm::length(direction) + meshlet.bounds.radius;
+}
+
+/**
+ * Constructor to create a meshlet builder with the given limits on the
+ * vertices and triangles of each meshlet.
+ */
+MeshletBuilder::MeshletBuilder(GLuint meshletVertices,
+                               GLuint meshletTriangles)
+{
+  maxVertices = meshletVertices;
+  maxTriangles = meshletTriangles;
+}
+
+/**
+ * Split the mesh's triangles into meshlets, and reorder its triangles so that
+ * each meshlet is a range of its indices. Each meshlet grows from the first
+ * triangle left, preferring the connected triangles that add the fewest new
+ * vertices, then the ones closest to its center that face the same way as
+ * the triangles it has, so its bounds and normal cone stay tight. A meshlet
+ * ends when it is full or has no connected triangles left that fit.
+ */
+GLvoid MeshletBuilder::buildMeshlets(Mesh& mesh)
+{
+  GLuint triangleCount = mesh.indices.size() / 3;
+  std::vector<glm::vec3> normals(triangleCount), centers(triangleCount);
+  std::vector<GLuint> adjacencyOffsets(mesh.vertices.size() + 1, 0);
+  std::vector<GLuint> adjacency(triangleCount * 3), adjacencyCounts;
+  std::vector<GLuint> vertexMeshlets(mesh.vertices.size(), NO_INDEX);
+  std::vector<GLuint> isTriangleAdded(triangleCount, false);
+  std::vector<GLuint> indices, meshletVertices;
+  GLuint nextTriangle = 0;
+
+  mesh.meshlets.clear();
+
+  for (GLuint i = 0; i < triangleCount; i++) {
+    const GLuint* triangle = &mesh.indices[i * 3];
+    glm::vec3 p0 = mesh.vertices[triangle[0]].position;
+    glm::vec3 p1 = mesh.vertices[triangle[1]].position;
+    glm::vec3 p2 = mesh.vertices[triangle[2]].position;
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+
+    normals[i] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+    centers[i] = (p0 + p1 + p2) / 3.0f;
+
+    for (GLuint j = 0; j < 3; j++) {
+      adjacencyOffsets[triangle[j] + 1]++;
+    }
+  }
+
+  // Build the list of triangles that use each vertex.
+  for (GLuint i = 0; i < mesh.vertices.size(); i++) {
+    adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+  }
+
+  adjacencyCounts.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+  for (GLuint i = 0; i < triangleCount * 3; i++) {
+    adjacency[adjacencyCounts[mesh.indices[i]]++] = i / 3;
+  }
+
+  indices.reserve(mesh.indices.size());
+
+  while (indices.size() < triangleCount * 3) {
+    GLuint meshlet = mesh.meshlets.size(), firstIndex = indices.size();
+    GLuint triangle;
+    glm::vec3 normalSum(0.0f), centerSum(0.0f);
+
+    while (isTriangleAdded[nextTriangle]) {
+      nextTriangle++;
+    }
+
+    triangle = nextTriangle;
+    meshletVertices.clear();
+
+    while (triangle != NO_INDEX) {
+      GLuint bestNewVertexCount = NO_INDEX;
+      GLfloat bestScore = 0.0f;
+      glm::vec3 axis, center;
+
+      // Add the triangle and any of its vertices new to the meshlet.
+      for (GLuint i = 0; i < 3; i++) {
+        GLuint vertex = mesh.indices[triangle * 3 + i];
+
+        if (vertexMeshlets[vertex] != meshlet) {
+          vertexMeshlets[vertex] = meshlet;
+          meshletVertices.push_back(vertex);
+        }
+
+        indices.push_back(vertex);
+      }
+
+      isTriangleAdded[triangle] = true;
+      normalSum += normals[triangle];
+      centerSum += centers[triangle];
+      triangle = NO_INDEX;
+
+      if (indices.size() - firstIndex >= maxTriangles * 3) {
+        break;
+      }
+
+      axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) :
+                                             normalSum;
+      center = centerSum * 3.0f / (GLfloat)(indices.size() - firstIndex);
+
+      // Pick the next triangle from the ones around the meshlet's vertices.
+      for (GLuint i = 0; i < meshletVertices.size(); i++) {
+        GLuint vertex = meshletVertices[i];
+
+        for (GLuint j = adjacencyOffsets[vertex];
+             j < adjacencyOffsets[vertex + 1]; j++) {
+          GLuint candidate = adjacency[j];
+          GLuint newVertexCount = 0;
+          GLfloat score;
+
+          if (isTriangleAdded[candidate]) {
+            continue;
+          }
+
+          for (GLuint k = 0; k < 3; k++) {
+            GLuint corner = mesh.indices[candidate * 3 + k];
+
+            newVertexCount += vertexMeshlets[corner] != meshlet;
+          }
+
+          if (meshletVertices.size() + newVertexCount > maxVertices) {
+            continue;
+          }
+
+          score = glm::length(centers[candidate] - center) *
+                  (1.0f + MESHLET_CONE_WEIGHT *
+                          (1.0f - glm::dot(normals[candidate], axis)));
+
+          if (newVertexCount < bestNewVertexCount ||
+              (newVertexCount == bestNewVertexCount && score < bestScore)) {
+            triangle = candidate;
+            bestNewVertexCount = newVertexCount;
+            bestScore = score;
+          }
+        }
+      }
+    }
+
+    mesh.meshlets.push_back(createMeshlet(mesh, indices, firstIndex,
+                                          indices.size() - firstIndex));
+  }
+
+  mesh.indices.swap(indices);
+}
+
+/**
+ * Create the meshlet of the given range of the mesh's new indices, with the
+ * bounding sphere of its vertices and the cone around its triangle normals.
+ * A meshlet whose normals spread over a hemisphere or more gets a cone that
+ * is never culled.
+ */
+Meshlet MeshletBuilder::createMeshlet(const Mesh& mesh,
+                                      const std::vector<GLuint>& indices,
+                                      GLuint firstIndex, GLuint indexCount)
+{
+  Meshlet meshlet;
+  std::vector<glm::vec3> normals;
+  glm::vec3 normalSum(0.0f);
+  GLfloat minDot = 1.0f;
+  Bounds& bounds = meshlet.bounds;
+
+  meshlet.firstIndex = firstIndex;
+  meshlet.indexCount = indexCount;
+  bounds.min = bounds.max = mesh.vertices[indices[firstIndex]].position;
+
+  for (GLuint i = firstIndex; i < firstIndex + indexCount; i += 3) {
+    glm::vec3 p0 = mesh.vertices[indices[i]].position;
+    glm::vec3 p1 = mesh.vertices[indices[i + 1]].position;
+    glm::vec3 p2 = mesh.vertices[indices[i + 2]].position;
+    glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+
+    bounds.min = glm::min(glm::min(bounds.min, p0), glm::min(p1, p2));
+    bounds.max = glm::max(glm::max(bounds.max, p0), glm::max(p1, p2));
+
+    if (glm::length(normal) > 0.0f) {
+      normals.push_back(glm::normalize(normal));
+      normalSum += normals.back();
+    }
+  }
+
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  bounds.radius = glm::length(bounds.max - bounds.center);
+  meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+  meshlet.coneCutoff = 1.0f;
+
+  if (normals.empty() || glm::length(normalSum) == 0.0f) {
+    return meshlet;
+  }
+
+  meshlet.coneAxis = glm::normalize(normalSum);
+
+  for (GLuint i = 0; i < normals.size(); i++) {
+    minDot = std::min(minDot, glm::dot(meshlet.coneAxis, normals[i]));
+  }
+
+  // The cone is only useful while it is narrower than a hemisphere.
+  if (minDot > 0.0f) {
+    meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+  }
+
+  return meshlet;
+}
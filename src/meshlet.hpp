@@ -0,0 +1,34 @@
+/**
+ * [Program description]
+ */
+
+#ifndef MESHLET_HEADER
+#define MESHLET_HEADER
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "mesh.hpp"
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_CONE_WEIGHT   4.0f // how much facing away adds to distance
+
+GLuint isMeshletBackFacing(const Meshlet& meshlet, glm::vec3 viewPosition);
+
+class MeshletBuilder
+{
+  public:
+    GLuint maxVertices;
+    GLuint maxTriangles;
+
+    MeshletBuilder(GLuint meshletVertices = MESHLET_MAX_VERTICES,
+                   GLuint meshletTriangles = MESHLET_MAX_TRIANGLES);
+    GLvoid buildMeshlets(Mesh& mesh);
+
+  private:
+    Meshlet createMeshlet(const Mesh& mesh,
+                          const std::vector<GLuint>& indices,
+                          GLuint firstIndex, GLuint indexCount);
+};
+
+#endif
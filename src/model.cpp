@@ -16,14 +16,351 @@ Model::Model(std::string modelFilepath)
 
   minX = minY = minZ = maxX = maxY = maxZ = 0.0f;
   centerPosition = glm::vec3(0.0f);
+  vao = vbo = ebo = 0;
+  isCacheEnabled = true;
+  isCacheLoaded = false;
+  textureThreadCount = 0;
+  isTextureBakingEnabled = true;
+  isTextureCompressionEnabled = false;
+  isTexturePackingEnabled = false;
+  isObjLoaderEnabled = true;
+  isOptimizationEnabled = true;
+  isLodEnabled = false;
+  isMeshletEnabled = false;
+  isDirectImportEnabled = false;
+  isGpuResidentEnabled = false;
+  isPositionStreamEnabled = false;
+  isNormalizeEnabled = false;
+  normalizeMin = -1.0f;
+  normalizeMax = 1.0f;
+  instanceVao = instanceBuffer = instances = 0;
+  vertexTexture = indexTexture = 0;
+  pullVao = pullInstanceVao = 0;
+  positionBuffer = normalBuffer = 0;
+  positionVao = positionInstanceVao = 0;
 }
 
+/**
+ * Load the model's meshes and textures. If caching is enabled, the converted
+ * meshes are read from the model's binary cache when it is up to date, and
+ * the cache is (re)written after importing the source file otherwise. OBJ
+ * files are imported with the built-in parser if it is enabled, and any other
+ * file with Assimp. Assimp imports can be written straight into the model's
+ * buffers, which skips the optimisation and cache.
+ */
 GLvoid Model::load()
 {
-  Assimp::Importer importer;
+  TraceZone zone("Model::load");
+
+  zone.addArgument("file", filepath);
+
+  readMeshes();
+  uploadMeshes();
+}
+
+/**
+ * Read the meshes from the cache or import them from the source file, without
+ * touching OpenGL, so that it can run on any thread. Direct imports are left
+ * to uploadMeshes, as they are written straight into the buffers.
+ */
+GLvoid Model::readMeshes()
+{
+  TraceZone zone("Model::readMeshes");
+
+  zone.addArgument("file", filepath);
+  isCacheLoaded = isCacheEnabled && loadCache();
+
+  if (!isCacheLoaded && !isDirectImport()) {
+    importMeshes(meshes);
+  }
+}
+
+/**
+ * Upload the meshes read by readMeshes and load their textures. This needs a
+ * current context. The model is normalized once it is loaded if normalizing
+ * is enabled. In GPU resident mode, the meshes' vertices and indices are then
+ * freed for good; later passes over them read the model's buffers instead.
+ */
+GLvoid Model::uploadMeshes()
+{
+  if (isCacheLoaded) {
+    // The bounds are read from the cache.
+    upload();
+    loadTextures();
+  } else if (isDirectImport()) {
+    Assimp::Importer importer;
+
+    importDirect(readScene(importer));
+    calculateBoundingBox();
+    loadTextures();
+  } else {
+    upload();
+    calculateBoundingBox();
+    loadTextures();
+
+    if (isCacheEnabled) {
+      ModelCache cache(filepath, importOptions());
+      cache.write(meshes, minX, maxX, minY, maxY, minZ, maxZ);
+    }
+  }
+
+  if (isNormalizeEnabled) {
+    normalize(normalizeMin, normalizeMax);
+  }
+
+  createCuller();
+  createVertexTextures();
+
+  if (isPositionStreamEnabled) {
+    createPositionStream();
+  }
+
+  if (isGpuResidentEnabled) {
+    releaseMeshData();
+  }
+}
+
+/**
+ * Create the GPU culler of the model's meshes, with its own vertex array on
+ * the model's buffers, if the context supports it.
+ */
+GLvoid Model::createCuller()
+{
+  culler.destroy();
+
+  if (!culler.create(meshes)) {
+    return;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  setVertexAttributes();
+  glBindVertexArray(0);
+}
+
+/**
+ * Create buffer textures over the model's vertex and index buffers, and an
+ * empty vertex array, for the programs that fetch their own vertices. Each
+ * vertex is two texels. Nothing is created if either buffer has more texels
+ * than a buffer texture can hold, and those programs cannot draw the model.
+ */
+GLvoid Model::createVertexTextures()
+{
+  GLint maxTexels, vertexBytes, indexBytes;
+
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+  glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+  glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &vertexBytes);
+  glBindBuffer(GL_COPY_READ_BUFFER, ebo);
+  glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &indexBytes);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+  if (vertexBytes / (GLint)sizeof(glm::vec4) > maxTexels ||
+      indexBytes / (GLint)sizeof(GLuint) > maxTexels) {
+    return;
+  }
+
+  glGenTextures(1, &vertexTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, vertexTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, vbo);
+
+  glGenTextures(1, &indexTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, ebo);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  glGenVertexArrays(1, &pullVao);
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    meshes[i].vertexTexture = vertexTexture;
+    meshes[i].indexTexture = indexTexture;
+  }
+}
+
+/**
+ * Copy the positions and normals of the model's vertices into their own
+ * tightly packed buffers, with a vertex array on them and the index buffer.
+ * Programs that read nothing else fetch 24 bytes a vertex from them instead
+ * of whole vertices. The vertices of meshes that are only in the vertex
+ * buffer are read back from it.
+ */
+GLvoid Model::createPositionStream()
+{
+  TraceZone zone("Model::createPositionStream");
+  std::vector<glm::vec3> positions, normals;
+  const Vertex* vertexData = NULL;
+  GLuint vertexCount = 0;
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    vertexCount = std::max(vertexCount, meshes[i].baseVertex +
+                                        meshes[i].vertexCount);
+  }
+
+  positions.resize(vertexCount);
+  normals.resize(vertexCount);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    const Vertex* vertices = meshes[i].vertices.data();
+
+    if (meshes[i].vertices.empty() && meshes[i].vertexCount) {
+      if (!vertexData) {
+        vertexData = (const Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                                     vertexCount *
+                                                     sizeof(Vertex),
+                                                     GL_MAP_READ_BIT);
+      }
+
+      if (!vertexData) {
+        fprintf(stderr, "\nLoad model error in file: %s\n%s\n",
+                filepath.c_str(), "Failed to map the vertex buffer");
+
+        exit(EXIT_FAILURE);
+      }
+
+      vertices = vertexData + meshes[i].baseVertex;
+    }
+
+    for (GLuint j = 0; j < meshes[i].vertexCount; j++) {
+      positions[meshes[i].baseVertex + j] = vertices[j].position;
+      normals[meshes[i].baseVertex + j] = vertices[j].normal;
+    }
+  }
+
+  if (vertexData) {
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+
+  zone.addArgument("bytes", (GLuint64)vertexCount * 2 * sizeof(glm::vec3));
+
+  glGenBuffers(1, &positionBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+  glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3),
+               positions.data(), GL_STATIC_DRAW);
+
+  glGenBuffers(1, &normalBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+  glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(glm::vec3),
+               normals.data(), GL_STATIC_DRAW);
+
+  glGenVertexArrays(1, &positionVao);
+  glBindVertexArray(positionVao);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  setPositionStreamAttributes();
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Point the bound vertex array's position and normal attributes at the
+ * position stream's buffers.
+ */
+GLvoid Model::setPositionStreamAttributes()
+{
+  glBindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                        (GLvoid*)0);
+
+  glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                        (GLvoid*)0);
+}
+
+/**
+ * Return whether programs that fetch their own vertices can draw the model.
+ */
+GLuint Model::canPullVertices() const
+{
+  return pullVao != 0;
+}
+
+/**
+ * Free the vertices and indices of every mesh. They are still in the model's
+ * buffers, and the mesh bounds and counts are kept.
+ */
+GLvoid Model::releaseMeshData()
+{
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    std::vector<Vertex>().swap(meshes[i].vertices);
+    std::vector<GLuint>().swap(meshes[i].indices);
+    std::vector<GLuint>().swap(meshes[i].lodIndices);
+  }
+}
+
+/**
+ * Return whether the source file is imported straight into the buffers.
+ */
+GLuint Model::isDirectImport()
+{
+  return isDirectImportEnabled &&
+         !(isObjLoaderEnabled && hasExtension(filepath, ".obj"));
+}
+
+GLuint Model::importOptions()
+{
+  if (isDirectImport()) {
+    return 0;
+  }
+
+  return (isOptimizationEnabled ? IMPORT_OPTIMIZED : 0) |
+         (isLodEnabled ? IMPORT_LODS : 0) |
+         (isMeshletEnabled ? IMPORT_MESHLETS : 0);
+}
+
+/**
+ * Import the meshes from the source file into importedMeshes, with the
+ * model's import options.
+ */
+GLvoid Model::importMeshes(std::vector<Mesh>& importedMeshes)
+{
+  if (isObjLoaderEnabled && hasExtension(filepath, ".obj")) {
+    TraceZone zone("ObjLoader::load");
+    ObjLoader loader(filepath);
+
+    zone.addArgument("file", filepath);
+
+    if (!loader.load(importedMeshes)) {
+      fprintf(stderr, "\nLoad model error in file: %s\n%s\n",
+              filepath.c_str(), loader.error.c_str());
+
+      exit(EXIT_FAILURE);
+    }
+  } else {
+    Assimp::Importer importer;
+    const aiScene* scene = readScene(importer);
+    TraceZone zone("processNode");
+
+    processNode(scene->mRootNode, scene, importedMeshes);
+  }
+
+  if (importOptions() & IMPORT_OPTIMIZED) {
+    optimizeMeshes(importedMeshes);
+  } else if (importOptions() & IMPORT_LODS) {
+    weldMeshes(importedMeshes);
+  }
+
+  if (importOptions() & IMPORT_MESHLETS) {
+    buildMeshlets(importedMeshes);
+  }
+
+  if (importOptions() & IMPORT_LODS) {
+    buildLods(importedMeshes);
+  }
+}
+
+/**
+ * Read the source file with Assimp. The scene belongs to the importer.
+ */
+const aiScene* Model::readScene(Assimp::Importer& importer)
+{
+  TraceZone zone("Assimp::ReadFile");
   const aiScene* scene = importer.ReadFile(filepath,
                          aiProcess_Triangulate | aiProcess_FlipUVs);
 
+  zone.addArgument("file", filepath);
+
   if (!scene || !scene->mRootNode ||
       scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE) {
     fprintf(stderr, "\nLoad model error in file: %s\n%s\n",
@@ -32,37 +369,625 @@ GLvoid Model::load()
     exit(EXIT_FAILURE);
   }
 
-  processNode(scene->mRootNode, scene);
-  calculateBoundingBox();
+  return scene;
 }
 
 /**
- * Clear all the buffers used by each mesh in the model and free the memory used
- * by each mesh and loaded texture.
+ * Read the meshes and bounds from the model's binary cache. Returns false if
+ * there is no valid cache for the model's source file.
  */
-GLvoid Model::unload()
+GLuint Model::loadCache()
+{
+  TraceZone zone("Model::loadCache");
+  ModelCache cache(filepath, importOptions());
+
+  if (!cache.open()) {
+    return false;
+  }
+
+  meshes.reserve(cache.header->meshCount);
+
+  for (GLuint i = 0; i < cache.header->meshCount; i++) {
+    meshes.push_back(cache.readMesh(i));
+  }
+
+  minX = cache.header->minX;
+  maxX = cache.header->maxX;
+  minY = cache.header->minY;
+  maxY = cache.header->maxY;
+  minZ = cache.header->minZ;
+  maxZ = cache.header->maxZ;
+  centerPosition = glm::vec3(average({minX, maxX}),
+                             average({minY, maxY}),
+                             average({minZ, maxZ}));
+
+  cache.close();
+
+  return true;
+}
+
+/**
+ * Upload every mesh into one vertex buffer and one index buffer shared by the
+ * whole model, with one vertex array. Each mesh records its range of the
+ * buffers so it can be drawn with a base vertex.
+ */
+GLvoid Model::upload()
 {
+  TraceZone zone("Model::upload");
+  GLuint vertexCount = 0, indexCount = 0;
+
+  calculateMeshBounds();
+
   for (GLuint i = 0; i < meshes.size(); i++) {
-    meshes[i].unload();
+    meshes[i].baseVertex = vertexCount;
+    meshes[i].firstIndex = indexCount;
+    meshes[i].vertexCount = meshes[i].vertices.size();
+    meshes[i].indexCount = meshes[i].indices.size();
+    vertexCount += meshes[i].vertices.size();
+    indexCount += meshes[i].indices.size() + meshes[i].lodIndices.size();
+  }
+
+  zone.addArgument("vertices", vertexCount);
+  zone.addArgument("bytes", (GLuint64)vertexCount * sizeof(Vertex) +
+                            (GLuint64)indexCount * sizeof(GLuint));
+
+  createBuffers(vertexCount, indexCount);
+
+  // Each mesh's levels of detail follow its own indices.
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                    meshes[i].firstIndex * sizeof(GLuint),
+                    meshes[i].indices.size() * sizeof(GLuint),
+                    meshes[i].indices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                    (meshes[i].firstIndex + meshes[i].indexCount) *
+                    sizeof(GLuint),
+                    meshes[i].lodIndices.size() * sizeof(GLuint),
+                    meshes[i].lodIndices.data());
+  }
+
+  updateVertices();
+  glBindVertexArray(0);
+}
+
+/**
+ * Create the model's vertex array and its vertex and index buffers with the
+ * given sizes, leaving them bound.
+ */
+GLvoid Model::createBuffers(GLuint vertexCount, GLuint indexCount)
+{
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &ebo);
+
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), NULL,
+               GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), NULL,
+               GL_STATIC_DRAW);
+
+  setVertexAttributes();
+}
+
+/**
+ * Point the bound vertex array's vertex attributes at the model's vertex
+ * buffer, which must be bound.
+ */
+GLvoid Model::setVertexAttributes()
+{
+  // Vertex positions
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, position));
+  // Normals
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, normal));
+  // Texture coordinates
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, textureCoords));
+}
+
+/**
+ * Convert the scene's meshes straight into the model's buffers. The buffers
+ * are sized from the Assimp meshes and mapped, and each mesh is converted
+ * into its range of the mappings in parallel, so no vertex or index is held
+ * in memory anywhere else. Each mesh's bounds are found from the Assimp
+ * positions as it is converted.
+ */
+GLvoid Model::importDirect(const aiScene* scene)
+{
+  TraceZone zone("Model::importDirect");
+  std::vector<aiMesh*> sceneMeshes;
+  std::vector<Bounds> meshBounds;
+  GLuint vertexCount = 0, indexCount = 0;
+  Vertex* vertexData;
+  GLuint* indexData;
+
+  collectMeshes(scene->mRootNode, scene, sceneMeshes);
+  meshes.resize(sceneMeshes.size());
+  meshBounds.resize(sceneMeshes.size());
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    meshes[i].baseVertex = vertexCount;
+    meshes[i].firstIndex = indexCount;
+    meshes[i].vertexCount = sceneMeshes[i]->mNumVertices;
+    meshes[i].indexCount = countIndices(sceneMeshes[i]);
+    meshes[i].textures = readMeshTextures(sceneMeshes[i], scene);
+    vertexCount += meshes[i].vertexCount;
+    indexCount += meshes[i].indexCount;
+  }
+
+  zone.addArgument("file", filepath);
+  zone.addArgument("vertices", vertexCount);
+  zone.addArgument("bytes", (GLuint64)vertexCount * sizeof(Vertex) +
+                            (GLuint64)indexCount * sizeof(GLuint));
+
+  createBuffers(vertexCount, indexCount);
+
+  vertexData = (Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                         vertexCount * sizeof(Vertex),
+                                         GL_MAP_WRITE_BIT |
+                                         GL_MAP_INVALIDATE_BUFFER_BIT);
+  indexData = (GLuint*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0,
+                                        indexCount * sizeof(GLuint),
+                                        GL_MAP_WRITE_BIT |
+                                        GL_MAP_INVALIDATE_BUFFER_BIT);
+
+  if (!vertexData || !indexData) {
+    fprintf(stderr, "\nLoad model error in file: %s\n%s\n",
+            filepath.c_str(), "Failed to map the model's buffers");
+
+    exit(EXIT_FAILURE);
+  }
+
+  parallelFor(meshes.size(), 0, [&](GLuint i) {
+    const aiMesh* sceneMesh = sceneMeshes[i];
+    Bounds& bounds = meshes[i].bounds;
+
+    convertMesh(sceneMesh, vertexData + meshes[i].baseVertex,
+                indexData + meshes[i].firstIndex);
+
+    bounds.min = glm::vec3(std::numeric_limits<GLfloat>::max());
+    bounds.max = glm::vec3(-std::numeric_limits<GLfloat>::max());
+
+    if (sceneMesh->mNumVertices) {
+      findPositionBounds(&sceneMesh->mVertices[0].x, sceneMesh->mNumVertices,
+                         3, bounds.min, bounds.max);
+    } else {
+      bounds.min = bounds.max = glm::vec3(0.0f);
+    }
+
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    bounds.radius = glm::length(bounds.max - bounds.center);
+    meshBounds[i] = bounds;
+  });
+
+  // The data store is undefined if it was lost while mapped.
+  if (!glUnmapBuffer(GL_ARRAY_BUFFER) ||
+      !glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER)) {
+    fprintf(stderr, "\nLoad model error in file: %s\n%s\n",
+            filepath.c_str(), "The model's buffers were lost while mapped");
+
+    exit(EXIT_FAILURE);
+  }
+
+  glBindVertexArray(0);
+  boundsTree.build(meshBounds);
+}
+
+/**
+ * Copy every mesh's vertices into the model's vertex buffer, skipping the
+ * meshes whose vertices are only in the buffer.
+ */
+GLvoid Model::updateVertices()
+{
+  TraceZone zone("glBufferSubData");
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    if (meshes[i].vertices.empty()) {
+      continue;
+    }
+
+    glBufferSubData(GL_ARRAY_BUFFER, meshes[i].baseVertex * sizeof(Vertex),
+                    meshes[i].vertices.size() * sizeof(Vertex),
+                    meshes[i].vertices.data());
+  }
+}
+
+/**
+ * Calculate the bounds of every mesh and build the hierarchy used to cull
+ * them. Meshes whose vertices are only in the model's buffers keep the
+ * bounds they were given when they were imported.
+ */
+GLvoid Model::calculateMeshBounds()
+{
+  TraceZone zone("Model::calculateMeshBounds");
+  std::vector<Bounds> meshBounds(meshes.size());
+
+  parallelFor(meshes.size(), 0, [&](GLuint i) {
+    if (!meshes[i].vertices.empty() || !meshes[i].vertexCount) {
+      meshes[i].calculateBounds();
+    }
+
+    meshBounds[i] = meshes[i].bounds;
+  });
+
+  boundsTree.build(meshBounds);
+}
+
+/**
+ * Weld each mesh's vertices and reorder its triangles and vertices for the
+ * post-transform cache and vertex fetch, then report the vertex cache
+ * statistics before and after.
+ */
+GLvoid Model::optimizeMeshes(std::vector<Mesh>& importedMeshes)
+{
+  TraceZone zone("Model::optimizeMeshes");
+  std::vector<OptimizationReport> reports(importedMeshes.size());
+
+  parallelFor(importedMeshes.size(), 0, [&](GLuint i) {
+    TraceZone meshZone("MeshOptimizer::optimize");
+    MeshOptimizer optimizer;
+
+    meshZone.addArgument("vertices", importedMeshes[i].vertices.size());
+    reports[i] = optimizer.optimize(importedMeshes[i]);
+  });
+
+  printf("Optimised meshes in %s\n", filepath.c_str());
+
+  for (GLuint i = 0; i < reports.size(); i++) {
+    printf("mesh %u: vertices %u -> %u, ACMR %.3f -> %.3f, "
+           "ATVR %.3f -> %.3f\n", i,
+           reports[i].originalVertexCount, reports[i].optimizedVertexCount,
+           reports[i].original.acmr, reports[i].optimized.acmr,
+           reports[i].original.atvr, reports[i].optimized.atvr);
+  }
+}
+
+/**
+ * Weld each mesh's vertices without reordering them. The simplifier locks
+ * every vertex that shares its position with another, so the unwelded
+ * corners of imported faces would keep it from collapsing anything.
+ */
+GLvoid Model::weldMeshes(std::vector<Mesh>& importedMeshes)
+{
+  TraceZone zone("Model::weldMeshes");
+
+  parallelFor(importedMeshes.size(), 0, [&](GLuint i) {
+    MeshOptimizer optimizer;
+    optimizer.weldVertices(importedMeshes[i]);
+  });
+}
+
+/**
+ * Build each mesh's chain of simplified levels of detail.
+ */
+GLvoid Model::buildLods(std::vector<Mesh>& importedMeshes)
+{
+  TraceZone zone("Model::buildLods");
+  GLuint64 indexCount = 0, lodIndexCount = 0;
+
+  parallelFor(importedMeshes.size(), 0, [&](GLuint i) {
+    TraceZone meshZone("MeshSimplifier::buildLods");
+    MeshSimplifier simplifier;
+
+    meshZone.addArgument("triangles", importedMeshes[i].indices.size() / 3);
+    simplifier.buildLods(importedMeshes[i]);
+  });
+
+  for (GLuint i = 0; i < importedMeshes.size(); i++) {
+    indexCount += importedMeshes[i].indices.size();
+    lodIndexCount += importedMeshes[i].lodIndices.size();
+  }
+
+  printf("Built levels of detail in %s: %llu extra triangles over %llu\n",
+         filepath.c_str(), (unsigned long long)lodIndexCount / 3,
+         (unsigned long long)indexCount / 3);
+}
+
+/**
+ * Split each mesh into meshlets that can be culled on their own. This groups
+ * each mesh's triangles by meshlet, so it runs before the LODs are built.
+ */
+GLvoid Model::buildMeshlets(std::vector<Mesh>& importedMeshes)
+{
+  TraceZone zone("Model::buildMeshlets");
+
+  parallelFor(importedMeshes.size(), 0, [&](GLuint i) {
+    MeshletBuilder builder;
+
+    builder.buildMeshlets(importedMeshes[i]);
+  });
+}
+
+/**
+ * Clear the buffers used by the model and free the memory used by each mesh
+ * and loaded texture.
+ */
+GLvoid Model::unload()
+{
+  culler.destroy();
+  glDeleteVertexArrays(1, &vao);
+  glDeleteBuffers(1, &vbo);
+  glDeleteBuffers(1, &ebo);
+  glDeleteVertexArrays(1, &instanceVao);
+  glDeleteBuffers(1, &instanceBuffer);
+  instanceVao = instanceBuffer = instances = 0;
+  glDeleteTextures(1, &vertexTexture);
+  glDeleteTextures(1, &indexTexture);
+  glDeleteVertexArrays(1, &pullVao);
+  glDeleteVertexArrays(1, &pullInstanceVao);
+  vertexTexture = indexTexture = pullVao = pullInstanceVao = 0;
+  glDeleteBuffers(1, &positionBuffer);
+  glDeleteBuffers(1, &normalBuffer);
+  glDeleteVertexArrays(1, &positionVao);
+  glDeleteVertexArrays(1, &positionInstanceVao);
+  positionBuffer = normalBuffer = positionVao = positionInstanceVao = 0;
+
+  for (GLuint i = 0; i < loadedTextures.size(); i++) {
+    glDeleteTextures(1, &loadedTextures[i].id);
   }
 
   meshes.clear();
   loadedTextures.clear();
 }
 
-GLvoid Model::draw(Shader shader, GLuint isCullingEnabled)
+/**
+ * Add a draw of each mesh to the given render pass of the queue, with the
+ * given model transform. If frustum planes (in world space) are given, only
+ * the meshes whose bounds are in the frustum are drawn, and with meshlet
+ * culling, only their meshlets in the frustum and facing the camera. The GPU
+ * culler's draws are indexed, so programs that fetch their own vertices are
+ * always culled on the CPU.
+ */
+GLvoid Model::submit(RenderQueue& queue, GLuint pass, const Shader& shader,
+                     const glm::mat4& transform,
+                     const glm::vec4* frustumPlanes)
+{
+  GLuint transformIndex = queue.addTransform(transform);
+  glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+  glm::vec3 viewPosition;
+  GLuint slot, isBackFaceCulled = false;
+
+  if (queue.isGpuCullingEnabled && queue.cullShader && culler.isCreated() &&
+      !shader.pulledPrimitive) {
+    if (frustumPlanes) {
+      transformPlanes(transform, frustumPlanes, planes);
+    }
+
+    slot = culler.cull(*queue.cullShader, frustumPlanes ? planes : NULL);
+
+    for (GLuint i = 0; i < culler.batchCount(); i++) {
+      const Mesh& mesh = meshes[culler.batchMesh(i)];
+      queue.submit(pass, shader, culler.vertexArray(), transformIndex, mesh,
+                   mesh.bounds.center, &culler, slot, i);
+    }
+
+    return;
+  }
+
+  // Back-facing meshlets are only culled if the pass culls back faces, and
+  // never for programs that draw lines from the vertices, e.g. normals.
+  if (queue.isMeshletCullingEnabled &&
+      queue.passState(pass).isCullingEnabled && !shader.isLineDrawn) {
+    viewPosition = glm::vec3(glm::inverse(queue.view() * transform)[3]);
+    isBackFaceCulled = true;
+  }
+
+  if (!frustumPlanes) {
+    for (GLuint i = 0; i < meshes.size(); i++) {
+      submitMesh(queue, pass, shader, transformIndex, meshes[i], NULL,
+                 isBackFaceCulled ? &viewPosition : NULL);
+    }
+
+    queue.statistics.visibleMeshCount += meshes.size();
+    return;
+  }
+
+  transformPlanes(transform, frustumPlanes, planes);
+  visibleMeshes.clear();
+  boundsTree.cull(planes, visibleMeshes);
+
+  for (GLuint i = 0; i < visibleMeshes.size(); i++) {
+    submitMesh(queue, pass, shader, transformIndex,
+               meshes[visibleMeshes[i]], planes,
+               isBackFaceCulled ? &viewPosition : NULL);
+  }
+
+  queue.statistics.visibleMeshCount += visibleMeshes.size();
+  queue.statistics.culledMeshCount += meshes.size() - visibleMeshes.size();
+}
+
+/**
+ * Add a draw of the given mesh to the render queue. If meshlet culling is
+ * enabled and the mesh has meshlets, only the meshlets inside the given
+ * frustum planes (if any) that do not face away from the given view position
+ * (if any) are drawn, as one draw of their merged index ranges. The planes
+ * and position are in model space.
+ */
+GLvoid Model::submitMesh(RenderQueue& queue, GLuint pass, const Shader& shader,
+                         GLuint transformIndex, const Mesh& mesh,
+                         const glm::vec4* planes,
+                         const glm::vec3* viewPosition)
+{
+  GLuint meshVao = vertexArray(shader, false);
+
+  if (!queue.isMeshletCullingEnabled || mesh.meshlets.empty() ||
+      (!planes && !viewPosition)) {
+    queue.submit(pass, shader, meshVao, transformIndex, mesh,
+                 mesh.bounds.center);
+    return;
+  }
+
+  visibleRanges.clear();
+
+  for (GLuint i = 0; i < mesh.meshlets.size(); i++) {
+    const Meshlet& meshlet = mesh.meshlets[i];
+    IndexRange range = { meshlet.firstIndex, meshlet.indexCount };
+
+    if ((planes && testFrustum(meshlet.bounds, planes) == FRUSTUM_OUTSIDE) ||
+        (viewPosition && isMeshletBackFacing(meshlet, *viewPosition))) {
+      queue.statistics.culledMeshletCount++;
+      continue;
+    }
+
+    // Neighbouring meshlets are drawn as one range.
+    if (!visibleRanges.empty() && visibleRanges.back().firstIndex +
+        visibleRanges.back().indexCount == range.firstIndex) {
+      visibleRanges.back().indexCount += range.indexCount;
+    } else {
+      visibleRanges.push_back(range);
+    }
+  }
+
+  if (!visibleRanges.empty()) {
+    queue.submitRanges(pass, shader, meshVao, transformIndex, mesh,
+                       mesh.bounds.center, visibleRanges);
+  }
+}
+
+/**
+ * Set the instances drawn by submitInstanced, each with the given model space
+ * transform and the tint at the same index, or white if there is none. The
+ * instances are kept in a buffer read by their own vertex arrays on the
+ * model's buffers (and one without vertices for programs that fetch their
+ * own, and one on the position stream), so they are only uploaded when they
+ * change.
+ */
+GLvoid Model::setInstances(const std::vector<glm::mat4>& transforms,
+                           const std::vector<glm::vec4>& tints)
+{
+  std::vector<Instance> instanceData(transforms.size());
+
+  for (GLuint i = 0; i < transforms.size(); i++) {
+    instanceData[i].transform = transforms[i];
+    instanceData[i].tint = (i < tints.size()) ? tints[i] : glm::vec4(1.0f);
+  }
+
+  if (!instanceVao) {
+    glGenVertexArrays(1, &instanceVao);
+    glGenBuffers(1, &instanceBuffer);
+
+    glBindVertexArray(instanceVao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    setVertexAttributes();
+    setInstanceAttributes();
+
+    if (pullVao) {
+      glGenVertexArrays(1, &pullInstanceVao);
+      glBindVertexArray(pullInstanceVao);
+      setInstanceAttributes();
+    }
+
+    if (positionVao) {
+      glGenVertexArrays(1, &positionInstanceVao);
+      glBindVertexArray(positionInstanceVao);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+      setPositionStreamAttributes();
+      setInstanceAttributes();
+    }
+
+    glBindVertexArray(0);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(Instance),
+               instanceData.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  instances = instanceData.size();
+}
+
+/**
+ * Point the bound vertex array's instance attributes at the instance buffer.
+ * Each column of the transform is its own attribute.
+ */
+GLvoid Model::setInstanceAttributes()
+{
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+  for (GLuint i = 0; i < 4; i++) {
+    glEnableVertexAttribArray(INSTANCE_TRANSFORM_ATTRIBUTE + i);
+    glVertexAttribPointer(INSTANCE_TRANSFORM_ATTRIBUTE + i, 4, GL_FLOAT,
+                          GL_FALSE, sizeof(Instance),
+                          (GLvoid*)(offsetof(Instance, transform) +
+                                    i * sizeof(glm::vec4)));
+    glVertexAttribDivisor(INSTANCE_TRANSFORM_ATTRIBUTE + i, 1);
+  }
+
+  glEnableVertexAttribArray(INSTANCE_TINT_ATTRIBUTE);
+  glVertexAttribPointer(INSTANCE_TINT_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE,
+                        sizeof(Instance), (GLvoid*)offsetof(Instance, tint));
+  glVertexAttribDivisor(INSTANCE_TINT_ATTRIBUTE, 1);
+}
+
+GLuint Model::instanceCount() const
+{
+  return instances;
+}
+
+/**
+ * Return the vertex array that the given program draws the model with, with
+ * or without the instance attributes: one without vertices for programs that
+ * fetch their own, the position stream for programs that only read positions
+ * and normals (if the model has one), or otherwise the whole vertices.
+ */
+GLuint Model::vertexArray(const Shader& shader, GLuint isInstanced) const
+{
+  if (shader.pulledPrimitive) {
+    return isInstanced ? pullInstanceVao : pullVao;
+  } else if (shader.isPositionStreamUsed && positionVao) {
+    return isInstanced ? positionInstanceVao : positionVao;
+  }
+
+  return isInstanced ? instanceVao : vao;
+}
+
+/**
+ * Add an instanced draw of every mesh to the given pass of the render queue,
+ * drawing each of the model's instances with the given transform applied
+ * after its own. The instances are not frustum culled.
+ */
+GLvoid Model::submitInstanced(RenderQueue& queue, GLuint pass,
+                              const Shader& shader, const glm::mat4& transform)
 {
-  if (isCullingEnabled) {
-    glEnable(GL_CULL_FACE);
+  GLuint transformIndex;
+  GLuint meshVao = vertexArray(shader, true);
+
+  if (!instances) {
+    return;
   }
 
+  transformIndex = queue.addTransform(transform);
+
   for (GLuint i = 0; i < meshes.size(); i++) {
-    meshes[i].draw(shader);
+    queue.submitInstanced(pass, shader, meshVao, transformIndex,
+                          meshes[i], meshes[i].bounds.center, instances);
   }
+}
 
-  if (isCullingEnabled) {
-    glDisable(GL_CULL_FACE);
+/**
+ * Move the given world space frustum planes into the space of a model with
+ * the given transform, rather than the model's bounds into world space.
+ */
+GLvoid Model::transformPlanes(const glm::mat4& transform,
+                              const glm::vec4* frustumPlanes,
+                              glm::vec4* planes)
+{
+  glm::mat4 planeTransform = glm::transpose(transform);
+
+  for (GLuint i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+    planes[i] = planeTransform * frustumPlanes[i];
   }
+
+  normalizePlanes(planes);
 }
 
 /**
@@ -70,8 +995,9 @@ GLvoid Model::draw(Shader shader, GLuint isCullingEnabled)
  */
 GLvoid Model::normalize(GLfloat min, GLfloat max)
 {
-  GLfloat x, y, z;
+  TraceZone zone("Model::normalize");
   GLfloat scaleFactor;
+  glm::vec3 offset(0.0f);
 
   GLfloat size = max - min;
   GLfloat magX = fabsf(maxX - minX);
@@ -80,217 +1006,317 @@ GLvoid Model::normalize(GLfloat min, GLfloat max)
 
   GLuint largestDimension = magY > magX ? magZ > magY ? Z : Y : X;
 
+  // Every axis is scaled by the largest dimension, and that dimension is
+  // also moved to start at min.
   switch (largestDimension) {
-    case X: scaleFactor = 1.0f / magX; break;
-    case Y: scaleFactor = 1.0f / magY; break;
-    case Z: scaleFactor = 1.0f / magZ; break;
+    case X:
+      scaleFactor = size / (maxX - minX);
+      offset.x = min - minX * scaleFactor;
+      break;
+    case Y:
+      scaleFactor = size / (maxY - minY);
+      offset.y = min - minY * scaleFactor;
+      break;
+    case Z:
+      scaleFactor = size / (maxZ - minZ);
+      offset.z = min - minZ * scaleFactor;
+      break;
+  }
+
+  parallelFor(meshes.size(), 0, [&](GLuint i) {
+    if (!meshes[i].vertices.empty()) {
+      remapPositions(&meshes[i].vertices[0].position.x,
+                     meshes[i].vertices.size(),
+                     sizeof(Vertex) / sizeof(GLfloat),
+                     glm::vec3(scaleFactor), offset);
+    } else if (meshes[i].vertexCount) {
+      Bounds& bounds = meshes[i].bounds;
+
+      bounds.min = bounds.min * scaleFactor + offset;
+      bounds.max = bounds.max * scaleFactor + offset;
+      bounds.center = bounds.center * scaleFactor + offset;
+      bounds.radius *= scaleFactor;
+    }
+
+    for (GLuint j = 0; j < meshes[i].meshlets.size(); j++) {
+      Bounds& bounds = meshes[i].meshlets[j].bounds;
+
+      bounds.min = bounds.min * scaleFactor + offset;
+      bounds.max = bounds.max * scaleFactor + offset;
+      bounds.center = bounds.center * scaleFactor + offset;
+      bounds.radius *= scaleFactor;
+    }
+  });
+
+  remapBufferPositions(glm::vec3(scaleFactor), offset);
+  calculateMeshBounds();
+  updateVertices();
+  calculateBoundingBox();
+
+  // The culler holds its own copy of the mesh bounds, and cull slots that
+  // kept meshes by the old ones, so it is created again.
+  if (culler.isCreated()) {
+    createCuller();
   }
+}
+
+/**
+ * Remap the positions of the meshes that only have their vertices in the
+ * model's vertex buffer, by mapping the buffer.
+ */
+GLvoid Model::remapBufferPositions(glm::vec3 scale, glm::vec3 offset)
+{
+  Vertex* vertexData = NULL;
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
   for (GLuint i = 0; i < meshes.size(); i++) {
-    for (GLuint j = 0; j < meshes[i].vertices.size(); j++) {
-      x = meshes[i].vertices[j].position.x;
-      y = meshes[i].vertices[j].position.y;
-      z = meshes[i].vertices[j].position.z;
-
-      switch (largestDimension) {
-        case X:
-          x = size * (x - minX) / (maxX - minX) + min;
-          y = size * (y * scaleFactor);
-          z = size * (z * scaleFactor);
-          break;
-        case Y:
-          x = size * (x * scaleFactor);
-          y = size * (y - minY) / (maxY - minY) + min;
-          z = size * (z * scaleFactor);
-          break;
-        case Z:
-          x = size * (x * scaleFactor);
-          y = size * (y * scaleFactor);
-          z = size * (z - minZ) / (maxZ - minZ) + min;
-          break;
-      }
+    if (!meshes[i].vertices.empty() || !meshes[i].vertexCount) {
+      continue;
+    }
+
+    if (!vertexData) {
+      vertexData = (Vertex*)glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
+
+      if (!vertexData) {
+        fprintf(stderr, "\nNormalize model error in file: %s\n%s\n",
+                filepath.c_str(), "Failed to map the vertex buffer");
 
-      meshes[i].vertices[j].position.x = x;
-      meshes[i].vertices[j].position.y = y;
-      meshes[i].vertices[j].position.z = z;
+        exit(EXIT_FAILURE);
+      }
     }
 
-    meshes[i].reload();
+    remapPositions(&vertexData[meshes[i].baseVertex].position.x,
+                   meshes[i].vertexCount, sizeof(Vertex) / sizeof(GLfloat),
+                   scale, offset);
   }
 
-  calculateBoundingBox();
+  if (vertexData) {
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
 }
 
-GLvoid Model::processNode(aiNode* node, const aiScene* scene)
+GLvoid Model::processNode(aiNode* node, const aiScene* scene,
+                          std::vector<Mesh>& importedMeshes)
 {
   // Process the meshes of this node.
   for (GLuint i = 0; i < node->mNumMeshes; i++) {
-    aiMesh* mesh = scene->mMeshes[node->mMeshes[i]]; 
-    meshes.push_back(processMesh(mesh, scene));     
+    aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+    importedMeshes.push_back(processMesh(mesh, scene));
   }
 
   // Process thes meshes of this node's children.
   for (GLuint i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene);
+    processNode(node->mChildren[i], scene, importedMeshes);
   }
 }
 
 Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 {
-  std::vector<Vertex> vertices;
-  std::vector<GLuint> indices;
-  std::vector<Texture> textures;
-  glm::vec3 vector;
+  TraceZone zone("processMesh");
+  Mesh result;
+
+  zone.addArgument("vertices", mesh->mNumVertices);
+  zone.addArgument("faces", mesh->mNumFaces);
+
+  result.vertices.resize(mesh->mNumVertices);
+  result.indices.resize(countIndices(mesh));
+  result.indexCount = result.indices.size();
+  result.textures = readMeshTextures(mesh, scene);
+
+  convertMesh(mesh, result.vertices.data(), result.indices.data());
 
+  return result;
+}
+
+/**
+ * Add the node's meshes and those of its children to sceneMeshes, in the
+ * same order as processNode.
+ */
+GLvoid Model::collectMeshes(aiNode* node, const aiScene* scene,
+                            std::vector<aiMesh*>& sceneMeshes)
+{
+  for (GLuint i = 0; i < node->mNumMeshes; i++) {
+    sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+  }
+
+  for (GLuint i = 0; i < node->mNumChildren; i++) {
+    collectMeshes(node->mChildren[i], scene, sceneMeshes);
+  }
+}
+
+GLuint Model::countIndices(const aiMesh* mesh)
+{
+  GLuint count = 0;
+
+  for (GLuint i = 0; i < mesh->mNumFaces; i++) {
+    count += mesh->mFaces[i].mNumIndices;
+  }
+
+  return count;
+}
+
+/**
+ * Write the mesh's vertices and indices into the given arrays, which must
+ * have room for mNumVertices vertices and countIndices(mesh) indices.
+ */
+GLvoid Model::convertMesh(const aiMesh* mesh, Vertex* vertices,
+                          GLuint* indices)
+{
   // Process vertex positions, normals and texture coordinates
-  for (GLuint i = 0; i < mesh->mNumVertices; i++)
-  {
-      Vertex vertex;
-
-      vector.x = mesh->mVertices[i].x;
-      vector.y = mesh->mVertices[i].y;
-      vector.z = mesh->mVertices[i].z; 
-      vertex.position = vector;
-
-      vector.x = mesh->mNormals[i].x;
-      vector.y = mesh->mNormals[i].y;
-      vector.z = mesh->mNormals[i].z;
-      vertex.normal = vector;
-
-      if(mesh->mTextureCoords[0]) {
-        vector.x = mesh->mTextureCoords[0][i].x; 
-        vector.y = mesh->mTextureCoords[0][i].y;
-      }
-      else {
-        vector.x = 0.0f;
-        vector.y = 0.0f;
-      }
-      vertex.textureCoords = glm::vec2(vector);
+  for (GLuint i = 0; i < mesh->mNumVertices; i++) {
+    Vertex& vertex = vertices[i];
+
+    vertex.position = glm::vec3(mesh->mVertices[i].x,
+                                mesh->mVertices[i].y,
+                                mesh->mVertices[i].z);
+
+    if (mesh->mNormals) {
+      vertex.normal = glm::vec3(mesh->mNormals[i].x,
+                                mesh->mNormals[i].y,
+                                mesh->mNormals[i].z);
+    } else {
+      vertex.normal = glm::vec3(0.0f);
+    }
 
-      vertices.push_back(vertex);
+    if (mesh->mTextureCoords[0]) {
+      vertex.textureCoords = glm::vec2(mesh->mTextureCoords[0][i].x,
+                                       mesh->mTextureCoords[0][i].y);
+    } else {
+      vertex.textureCoords = glm::vec2(0.0f);
+    }
   }
 
   // Process indices
   for (GLuint i = 0; i < mesh->mNumFaces; i++) {
-    aiFace face = mesh->mFaces[i];
+    const aiFace& face = mesh->mFaces[i];
 
     for (GLuint j = 0; j < face.mNumIndices; j++) {
-      indices.push_back(face.mIndices[j]);
+      *indices++ = face.mIndices[j];
     }
   }
+}
+
+std::vector<Texture> Model::readMeshTextures(const aiMesh* mesh,
+                                             const aiScene* scene)
+{
+  std::vector<Texture> textures;
 
   // Process material
   if (mesh->mMaterialIndex > 0) {
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-    std::vector<Texture> diffuseMaps = loadMaterialTextures(material, 
+    std::vector<Texture> diffuseMaps = readMaterialTextures(material,
                                     aiTextureType_DIFFUSE, "diffuse");
     textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
-    std::vector<Texture> specularMaps = loadMaterialTextures(material, 
+    std::vector<Texture> specularMaps = readMaterialTextures(material,
                                     aiTextureType_SPECULAR, "specular");
     textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
   }
 
-  Mesh newMesh(vertices, indices, textures);
-  newMesh.load();
-
-  return newMesh;
+  return textures;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* material,
+/**
+ * Read the file paths of the material's textures of the given type. The
+ * textures are loaded later by loadTextures, once every mesh is known.
+ */
+std::vector<Texture> Model::readMaterialTextures(aiMaterial* material,
                                                  aiTextureType type,
                                                  std::string typeName)
 {
   std::vector<Texture> textures;
   Texture texture;
-  aiString filepath;
-  GLuint isTextureAlreadyLoaded;
 
-  for (GLuint i = 0; i < material->GetTextureCount(type); i++) {
-    material->GetTexture(type, i, &filepath);
-    isTextureAlreadyLoaded = false;
-
-    // Check if the texture has already been loaded.
-    for (GLuint j = 0; j < loadedTextures.size(); j++) {
-      if (filepath == loadedTextures[j].filepath) {
-        textures.push_back(loadedTextures[j]);
-        isTextureAlreadyLoaded = true; 
-        break;
-      }
-    }
+  texture.id = 0;
+  texture.layer = 0;
+  texture.type = typeName;
 
-    // Otherwise load the texture.
-    if (!isTextureAlreadyLoaded) {
-      texture.id = loadTexture(filepath.C_Str(), directory);
-      texture.type = typeName;
-      texture.filepath = filepath;
-      textures.push_back(texture);
-      loadedTextures.push_back(texture);
-    }
+  for (GLuint i = 0; i < material->GetTextureCount(type); i++) {
+    material->GetTexture(type, i, &texture.filepath);
+    textures.push_back(texture);
   }
 
   return textures;
 }
 
-GLuint Model::loadTexture(const GLchar* filepath, std::string directory)
+/**
+ * Load every texture referenced by the model's meshes. Each file is loaded
+ * once, in parallel, and then its ID and array layer are assigned to every
+ * mesh that uses it.
+ */
+GLvoid Model::loadTextures()
 {
-  std::string filename(filepath);
-  filename = directory + '/' + filename;
+  TraceZone zone("Model::loadTextures");
+  TextureLoader loader(textureThreadCount);
+  std::map<std::string, GLuint> textureIDs;
+  std::map<std::string, GLuint> textureLayers;
+  std::vector<Texture> textures;
+  std::vector<std::string> filepaths;
+  std::vector<GLuint> loadedIDs, loadedLayers;
+
+  // Gather the unique texture file paths.
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    for (GLuint j = 0; j < meshes[i].textures.size(); j++) {
+      const Texture& texture = meshes[i].textures[j];
+      std::string filepath = texture.filepath.C_Str();
 
-  GLuint textureID;
-  glGenTextures(1, &textureID);
+      if (textureIDs.insert(std::make_pair(filepath, 0u)).second) {
+        textures.push_back(texture);
+        filepaths.push_back(directory + '/' + filepath);
+      }
+    }
+  }
 
-  GLint width, height;
-  GLubyte* image = stbi_load(filename.c_str(), &width, &height, 0, STBI_rgb_alpha);
+  loader.isBakingEnabled = isTextureBakingEnabled;
+  loader.isCompressionEnabled = isTextureCompressionEnabled;
+  loader.isPackingEnabled = isTexturePackingEnabled;
+  loadedIDs = loader.load(filepaths, loadedLayers);
 
-  glBindTexture(GL_TEXTURE_2D, textureID);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-               GL_UNSIGNED_BYTE, image);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  stbi_image_free(image);
+  for (GLuint i = 0; i < textures.size(); i++) {
+    textures[i].id = loadedIDs[i];
+    textures[i].layer = loadedLayers[i];
+    textureIDs[textures[i].filepath.C_Str()] = loadedIDs[i];
+    textureLayers[textures[i].filepath.C_Str()] = loadedLayers[i];
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glBindTexture(GL_TEXTURE_2D, 0);
+    // Packed textures share an array, which is only deleted once.
+    if (std::find(loadedIDs.begin(), loadedIDs.begin() + i, loadedIDs[i]) ==
+        loadedIDs.begin() + i) {
+      loadedTextures.push_back(textures[i]);
+    }
+  }
 
-  return textureID;
+  for (GLuint i = 0; i < meshes.size(); i++) {
+    for (GLuint j = 0; j < meshes[i].textures.size(); j++) {
+      Texture& texture = meshes[i].textures[j];
+      texture.id = textureIDs[texture.filepath.C_Str()];
+      texture.layer = textureLayers[texture.filepath.C_Str()];
+    }
+  }
 }
 
 GLvoid Model::calculateBoundingBox()
 {
   GLfloat maxFloatValue = std::numeric_limits<float>::max();
-  glm::vec3 vector;
-
-  minX = minY = minZ = maxFloatValue;
-  maxX = maxY = maxZ = -maxFloatValue;
+  glm::vec3 min(maxFloatValue), max(-maxFloatValue);
 
+  // The mesh bounds are found with the vectorised kernels in parallel by
+  // calculateMeshBounds, so only they need to be combined here.
   for (GLuint i = 0; i < meshes.size(); i++) {
-    for (GLuint j = 0; j < meshes[i].vertices.size(); j++) {
-      vector = meshes[i].vertices[j].position;
-
-      if (vector.x < minX) {
-        minX = vector.x;
-      } else if (vector.x > maxX) {
-        maxX = vector.x;
-      }
-
-      if (vector.y < minY) {
-        minY = vector.y;
-      } else if (vector.y > maxY) {
-        maxY = vector.y;
-      }
-
-      if (vector.z < minZ) {
-        minZ = vector.z;
-      } else if (vector.z > maxZ) {
-        maxZ = vector.z;
-      }
+    if (meshes[i].vertexCount) {
+      min = glm::min(min, meshes[i].bounds.min);
+      max = glm::max(max, meshes[i].bounds.max);
     }
   }
 
+  minX = min.x;
+  minY = min.y;
+  minZ = min.z;
+  maxX = max.x;
+  maxY = max.y;
+  maxZ = max.z;
+
   centerPosition = glm::vec3(average({minX, maxX}),
                              average({minY, maxY}),
                              average({minZ, maxZ}));
@@ -13,26 +13,67 @@
 #include <vector>
 
 #include "helpers.hpp"
+#include "trace.cpp"
+#include "bounds.cpp"
+#include "kernels.cpp"
 #include "mesh.cpp"
+#include "cache.cpp"
+#include "obj.cpp"
+#include "optimizer.cpp"
+#include "meshlet.cpp"
+#include "simplifier.cpp"
+#include "gpuculler.cpp"
+#include "gputimer.cpp"
+#include "renderer.cpp"
 #include "shader.hpp"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "third_party/stb_image.h"
+#include "baker.cpp"
+#include "texture.cpp"
 
 #define X 0
 #define Y 1
 #define Z 2
 
+// Import options that change the converted meshes, and so the cache.
+#define IMPORT_OPTIMIZED 0x1
+#define IMPORT_LODS      0x2
+#define IMPORT_MESHLETS  0x4
+
 class Model
 {
   public:
     GLfloat minX, maxX, minY, maxY, minZ, maxZ;
     glm::vec3 centerPosition;
+    GLuint isCacheEnabled;
+    GLuint textureThreadCount;
+    GLuint isTextureBakingEnabled;
+    GLuint isTextureCompressionEnabled;
+    GLuint isTexturePackingEnabled;
+    GLuint isObjLoaderEnabled;
+    GLuint isOptimizationEnabled;
+    GLuint isLodEnabled;
+    GLuint isMeshletEnabled;
+    GLuint isDirectImportEnabled;
+    GLuint isGpuResidentEnabled;
+    GLuint isPositionStreamEnabled;
+    GLuint isNormalizeEnabled;
+    GLfloat normalizeMin, normalizeMax;
 
     Model(std::string modelFilepath = "");
     GLvoid load();
+    GLvoid readMeshes();
+    GLvoid uploadMeshes();
+    GLvoid releaseMeshData();
     GLvoid unload();
-    GLvoid draw(Shader shader, GLuint isCullingEnabled);
+    GLvoid submit(RenderQueue& queue, GLuint pass, const Shader& shader,
+                  const glm::mat4& transform,
+                  const glm::vec4* frustumPlanes = NULL);
+    GLvoid setInstances(const std::vector<glm::mat4>& transforms,
+                        const std::vector<glm::vec4>& tints =
+                        std::vector<glm::vec4>());
+    GLuint instanceCount() const;
+    GLuint canPullVertices() const;
+    GLvoid submitInstanced(RenderQueue& queue, GLuint pass,
+                           const Shader& shader, const glm::mat4& transform);
     GLvoid normalize(GLfloat min, GLfloat max);
     GLvoid printBoundingBox();
 
@@ -41,13 +82,59 @@ class Model
     std::vector<Texture> loadedTextures;
     std::string filepath;
     std::string directory;
+    GLuint vao, vbo, ebo;
+    GLuint instanceVao, instanceBuffer;
+    GLuint instances;
+    GLuint vertexTexture, indexTexture;
+    GLuint pullVao, pullInstanceVao;
+    GLuint positionBuffer, normalBuffer;
+    GLuint positionVao, positionInstanceVao;
+    GLuint isCacheLoaded;
+    BoundsTree boundsTree;
+    GpuCuller culler;
+    std::vector<GLuint> visibleMeshes;
+    std::vector<IndexRange> visibleRanges;
 
-    GLvoid processNode(aiNode* node, const aiScene* scene);
+    GLuint isDirectImport();
+    GLuint importOptions();
+    GLvoid importMeshes(std::vector<Mesh>& importedMeshes);
+    const aiScene* readScene(Assimp::Importer& importer);
+    GLuint loadCache();
+    GLvoid optimizeMeshes(std::vector<Mesh>& importedMeshes);
+    GLvoid weldMeshes(std::vector<Mesh>& importedMeshes);
+    GLvoid buildLods(std::vector<Mesh>& importedMeshes);
+    GLvoid buildMeshlets(std::vector<Mesh>& importedMeshes);
+    GLvoid upload();
+    GLvoid createBuffers(GLuint vertexCount, GLuint indexCount);
+    GLvoid setVertexAttributes();
+    GLvoid createCuller();
+    GLvoid createVertexTextures();
+    GLvoid createPositionStream();
+    GLvoid setPositionStreamAttributes();
+    GLvoid setInstanceAttributes();
+    GLuint vertexArray(const Shader& shader, GLuint isInstanced) const;
+    GLvoid transformPlanes(const glm::mat4& transform,
+                           const glm::vec4* frustumPlanes, glm::vec4* planes);
+    GLvoid submitMesh(RenderQueue& queue, GLuint pass, const Shader& shader,
+                      GLuint transformIndex, const Mesh& mesh,
+                      const glm::vec4* planes, const glm::vec3* viewPosition);
+    GLvoid importDirect(const aiScene* scene);
+    GLvoid updateVertices();
+    GLvoid remapBufferPositions(glm::vec3 scale, glm::vec3 offset);
+    GLvoid calculateMeshBounds();
+    GLvoid processNode(aiNode* node, const aiScene* scene,
+                       std::vector<Mesh>& importedMeshes);
     Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* material,
+    GLvoid collectMeshes(aiNode* node, const aiScene* scene,
+                         std::vector<aiMesh*>& sceneMeshes);
+    GLuint countIndices(const aiMesh* mesh);
+    GLvoid convertMesh(const aiMesh* mesh, Vertex* vertices, GLuint* indices);
+    std::vector<Texture> readMeshTextures(const aiMesh* mesh,
+                                          const aiScene* scene);
+    std::vector<Texture> readMaterialTextures(aiMaterial* material,
                                               aiTextureType type,
                                               std::string typeName);
-    GLuint loadTexture(const GLchar* filepath, std::string directory);
+    GLvoid loadTextures();
     GLvoid calculateBoundingBox();
 };
   
@@ -0,0 +1,585 @@
+/**
+ * [Program description]
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "obj.hpp"
+
+/**
+ * Skip spaces and tabs, without moving past the end of the line.
+ */
+static const GLchar* skipSpaces(const GLchar* text, const GLchar* end)
+{
+  while (text < end && (*text == ' ' || *text == '\t')) {
+    text++;
+  }
+
+  return text;
+}
+
+/**
+ * Parse a decimal number (with an optional exponent) at the given position.
+ * Returns the position after the number. This avoids the locale handling and
+ * per-call overhead of strtof, which dominates parsing large files.
+ */
+static const GLchar* parseFloat(const GLchar* text, const GLchar* end,
+                                GLfloat* value)
+{
+  static const GLdouble powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+  };
+  GLdouble number = 0.0;
+  GLdouble fraction = 0.0;
+  GLint fractionDigits = 0;
+  GLint exponent = 0;
+  GLint sign = 1;
+
+  text = skipSpaces(text, end);
+
+  if (text < end && (*text == '-' || *text == '+')) {
+    sign = (*text == '-') ? -1 : 1;
+    text++;
+  }
+
+  while (text < end && *text >= '0' && *text <= '9') {
+    number = number * 10.0 + (*text++ - '0');
+  }
+
+  if (text < end && *text == '.') {
+    text++;
+
+    while (text < end && *text >= '0' && *text <= '9') {
+      if (fractionDigits < 18) {
+        fraction = fraction * 10.0 + (*text - '0');
+        fractionDigits++;
+      }
+
+      text++;
+    }
+
+    number += fraction / powers[fractionDigits];
+  }
+
+  if (text < end && (*text == 'e' || *text == 'E')) {
+    GLint exponentSign = 1;
+    text++;
+
+    if (text < end && (*text == '-' || *text == '+')) {
+      exponentSign = (*text == '-') ? -1 : 1;
+      text++;
+    }
+
+    while (text < end && *text >= '0' && *text <= '9') {
+      exponent = exponent * 10 + (*text++ - '0');
+    }
+
+    number *= pow(10.0, exponentSign * exponent);
+  }
+
+  *value = sign * number;
+
+  return text;
+}
+
+static const GLchar* parseInteger(const GLchar* text, const GLchar* end,
+                                  GLint* value)
+{
+  GLint number = 0;
+  GLint sign = 1;
+
+  if (text < end && *text == '-') {
+    sign = -1;
+    text++;
+  }
+
+  while (text < end && *text >= '0' && *text <= '9') {
+    number = number * 10 + (*text++ - '0');
+  }
+
+  *value = sign * number;
+
+  return text;
+}
+
+/**
+ * Return the rest of the line as a name, without surrounding whitespace.
+ */
+static std::string parseName(const GLchar* text, const GLchar* end)
+{
+  text = skipSpaces(text, end);
+
+  while (end > text && (end[-1] == ' ' || end[-1] == '\t')) {
+    end--;
+  }
+
+  return std::string(text, end);
+}
+
+/**
+ * Constructor to create a loader for the given OBJ file. If no thread count
+ * is given, one parsing thread is used per hardware thread.
+ */
+ObjLoader::ObjLoader(std::string modelFilepath, GLuint desiredThreadCount)
+{
+  filepath = modelFilepath;
+  directory = filepath.substr(0, filepath.find_last_of('/'));
+  threadCount = desiredThreadCount;
+}
+
+/**
+ * Load the meshes in the OBJ file. The file is mapped into memory and split
+ * into line-aligned chunks that are parsed in parallel, then the chunks are
+ * merged into one mesh per object and material, in file order. Each face
+ * corner becomes its own vertex and polygons are triangulated as fans, the
+ * same as the Assimp importer with aiProcess_Triangulate | aiProcess_FlipUVs.
+ * The returned meshes reference their textures by file path only.
+ */
+GLuint ObjLoader::load(std::vector<Mesh>& meshes)
+{
+  struct stat attributes;
+  GLint fd = open(filepath.c_str(), O_RDONLY);
+  const GLchar* data;
+  size_t size;
+
+  if (fd < 0 || fstat(fd, &attributes) != 0) {
+    error = "Unable to open file";
+
+    if (fd >= 0) {
+      close(fd);
+    }
+
+    return false;
+  }
+
+  size = attributes.st_size;
+
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+
+  data = (const GLchar*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    error = "Unable to map file";
+    return false;
+  }
+
+  madvise((GLvoid*)data, size, MADV_SEQUENTIAL);
+
+  // Split the file into chunks that each start at the beginning of a line.
+  const GLchar* begin = data;
+  const GLchar* end = data + size;
+
+  while (begin < end) {
+    ObjChunk chunk;
+    const GLchar* chunkEnd = begin + std::min<size_t>(OBJ_CHUNK_SIZE,
+                                                      end - begin);
+    const GLchar* lineEnd = (const GLchar*)memchr(chunkEnd, '\n',
+                                                  end - chunkEnd);
+
+    chunk.begin = begin;
+    chunk.end = lineEnd ? lineEnd + 1 : end;
+    chunks.push_back(chunk);
+    begin = chunk.end;
+  }
+
+  parallelFor(chunks.size(), threadCount, [&](GLuint i) {
+    parseChunk(chunks[i]);
+  });
+
+  munmap((GLvoid*)data, size);
+
+  for (GLuint i = 0; i < chunks.size(); i++) {
+    for (GLuint j = 0; j < chunks[i].materialLibraries.size(); j++) {
+      parseMaterials(directory + '/' + chunks[i].materialLibraries[j]);
+    }
+  }
+
+  // Group the chunks' triangle runs into meshes. A run continues the previous
+  // mesh unless it was started by an o, g or usemtl record.
+  std::vector<std::vector<std::pair<GLuint, GLuint> > > meshGroups;
+  std::vector<std::string> meshMaterials;
+  std::string currentMaterial;
+
+  for (GLuint i = 0; i < chunks.size(); i++) {
+    for (GLuint j = 0; j < chunks[i].groups.size(); j++) {
+      ObjGroup& group = chunks[i].groups[j];
+
+      if (!group.isMaterialKnown) {
+        group.material = currentMaterial;
+      }
+
+      currentMaterial = group.material;
+
+      if (group.isNewGroup || meshGroups.empty()) {
+        meshGroups.push_back(std::vector<std::pair<GLuint, GLuint> >());
+        meshMaterials.push_back(currentMaterial);
+      }
+
+      meshGroups.back().push_back(std::make_pair(i, j));
+    }
+  }
+
+  mergeChunks();
+
+  std::vector<Mesh> loadedMeshes(meshGroups.size(), Mesh());
+  std::vector<GLuint> isMeshValid(meshGroups.size(), true);
+
+  parallelFor(meshGroups.size(), threadCount, [&](GLuint i) {
+    isMeshValid[i] = createMesh(meshGroups[i], loadedMeshes[i]);
+  });
+
+  for (GLuint i = 0; i < loadedMeshes.size(); i++) {
+    if (!isMeshValid[i]) {
+      error = "Face index out of range";
+      return false;
+    }
+
+    if (loadedMeshes[i].indices.empty()) {
+      continue;
+    }
+
+    // Read the diffuse then specular maps, in the same order as processMesh.
+    std::map<std::string, ObjMaterial>::iterator material =
+      materials.find(meshMaterials[i]);
+
+    if (material != materials.end()) {
+      Texture texture;
+      texture.id = 0;
+      texture.layer = 0;
+      texture.type = "diffuse";
+
+      for (GLuint j = 0; j < material->second.diffuseMaps.size(); j++) {
+        texture.filepath.Set(material->second.diffuseMaps[j]);
+        loadedMeshes[i].textures.push_back(texture);
+      }
+
+      texture.type = "specular";
+
+      for (GLuint j = 0; j < material->second.specularMaps.size(); j++) {
+        texture.filepath.Set(material->second.specularMaps[j]);
+        loadedMeshes[i].textures.push_back(texture);
+      }
+    }
+
+    meshes.push_back(std::move(loadedMeshes[i]));
+  }
+
+  chunks.clear();
+  positions.clear();
+  normals.clear();
+  textureCoords.clear();
+
+  return true;
+}
+
+/**
+ * Parse the records in a chunk. Positions, normals and texture coordinates
+ * are stored per chunk and faces are triangulated into corners.
+ */
+GLvoid ObjLoader::parseChunk(ObjChunk& chunk)
+{
+  const GLchar* line = chunk.begin;
+  ObjGroup group;
+
+  group.isNewGroup = false;
+  group.isMaterialKnown = false;
+  group.firstCorner = group.lastCorner = 0;
+
+  while (line < chunk.end) {
+    const GLchar* lineEnd = (const GLchar*)memchr(line, '\n',
+                                                  chunk.end - line);
+    lineEnd = lineEnd ? lineEnd : chunk.end;
+
+    const GLchar* end = lineEnd;
+    const GLchar* text = skipSpaces(line, end);
+    line = lineEnd + 1;
+
+    if (end > text && end[-1] == '\r') {
+      end--;
+    }
+
+    if (end - text < 2) {
+      continue;
+    }
+
+    if (text[0] == 'v' && text[1] == ' ') {
+      glm::vec3 position;
+      text = parseFloat(text + 2, end, &position.x);
+      text = parseFloat(text, end, &position.y);
+      parseFloat(text, end, &position.z);
+      chunk.positions.push_back(position);
+    } else if (text[0] == 'v' && text[1] == 'n') {
+      glm::vec3 normal;
+      text = parseFloat(text + 2, end, &normal.x);
+      text = parseFloat(text, end, &normal.y);
+      parseFloat(text, end, &normal.z);
+      chunk.normals.push_back(normal);
+    } else if (text[0] == 'v' && text[1] == 't') {
+      glm::vec2 coords;
+      text = parseFloat(text + 2, end, &coords.x);
+      parseFloat(text, end, &coords.y);
+      coords.y = 1.0f - coords.y;
+      chunk.textureCoords.push_back(coords);
+    } else if (text[0] == 'f' && text[1] == ' ') {
+      parseFace(chunk, text + 2, end);
+    } else if (((text[0] == 'o' || text[0] == 'g') && text[1] == ' ') ||
+               (end - text > 6 && !strncmp(text, "usemtl", 6))) {
+      group.lastCorner = chunk.corners.size();
+
+      // Start a new run, unless the current one has no triangles yet.
+      if (group.lastCorner > group.firstCorner) {
+        chunk.groups.push_back(group);
+        group.firstCorner = group.lastCorner;
+      }
+
+      group.isNewGroup = true;
+
+      if (text[0] == 'u') {
+        group.material = parseName(text + 6, end);
+        group.isMaterialKnown = true;
+      }
+    } else if (end - text > 6 && !strncmp(text, "mtllib", 6)) {
+      chunk.materialLibraries.push_back(parseName(text + 6, end));
+    }
+  }
+
+  group.lastCorner = chunk.corners.size();
+  chunk.groups.push_back(group);
+}
+
+/**
+ * Parse a face record and triangulate it as a fan around the first corner.
+ */
+GLvoid ObjLoader::parseFace(ObjChunk& chunk, const GLchar* text,
+                            const GLchar* end)
+{
+  ObjCorner corner, first, previous;
+  GLint value;
+  GLuint cornerCount = 0;
+
+  while ((text = skipSpaces(text, end)) < end) {
+    corner.textureCoords = OBJ_MISSING;
+    corner.normal = OBJ_MISSING;
+    corner.isRelative = 0;
+
+    text = parseInteger(text, end, &value);
+    corner.position = value;
+
+    if (text < end && *text == '/') {
+      text++;
+
+      if (text < end && *text != '/') {
+        text = parseInteger(text, end, &value);
+        corner.textureCoords = value;
+      }
+
+      if (text < end && *text == '/') {
+        text = parseInteger(text + 1, end, &value);
+        corner.normal = value;
+      }
+    }
+
+    // Skip anything unexpected so a malformed corner cannot stall the parser.
+    while (text < end && *text != ' ' && *text != '\t') {
+      text++;
+    }
+
+    // Convert one-based indices to zero-based ones, and negative indices to
+    // indices relative to the start of the chunk.
+    if (corner.position < 0) {
+      corner.position += chunk.positions.size();
+      corner.isRelative |= 1;
+    } else {
+      corner.position--;
+    }
+
+    if (corner.textureCoords != OBJ_MISSING) {
+      if (corner.textureCoords < 0) {
+        corner.textureCoords += chunk.textureCoords.size();
+        corner.isRelative |= 2;
+      } else {
+        corner.textureCoords--;
+      }
+    }
+
+    if (corner.normal != OBJ_MISSING) {
+      if (corner.normal < 0) {
+        corner.normal += chunk.normals.size();
+        corner.isRelative |= 4;
+      } else {
+        corner.normal--;
+      }
+    }
+
+    if (cornerCount == 0) {
+      first = corner;
+    } else if (cornerCount >= 2) {
+      chunk.corners.push_back(first);
+      chunk.corners.push_back(previous);
+      chunk.corners.push_back(corner);
+    }
+
+    previous = corner;
+    cornerCount++;
+  }
+}
+
+/**
+ * Read the diffuse and specular map file paths of each material in the given
+ * material library.
+ */
+GLvoid ObjLoader::parseMaterials(std::string materialFilepath)
+{
+  std::ifstream file(materialFilepath);
+  std::string line;
+  ObjMaterial* material = NULL;
+
+  if (!file.is_open()) {
+    fprintf(stderr, "\nFailed to open material library: %s\n",
+            materialFilepath.c_str());
+    return;
+  }
+
+  while (getline(file, line)) {
+    std::stringstream stream(line);
+    std::string keyword, value, lastValue;
+
+    stream >> keyword;
+
+    // Texture map options come before the file path, so use the last item.
+    while (stream >> value) {
+      lastValue = value;
+    }
+
+    if (keyword == "newmtl") {
+      material = &materials[lastValue];
+    } else if (material && keyword == "map_Kd" && !lastValue.empty()) {
+      material->diffuseMaps.push_back(lastValue);
+    } else if (material && keyword == "map_Ks" && !lastValue.empty()) {
+      material->specularMaps.push_back(lastValue);
+    }
+  }
+}
+
+/**
+ * Concatenate the chunks' positions, normals and texture coordinates and
+ * record each chunk's offset into them.
+ */
+GLvoid ObjLoader::mergeChunks()
+{
+  GLuint positionCount = 0, normalCount = 0, textureCoordsCount = 0;
+
+  for (GLuint i = 0; i < chunks.size(); i++) {
+    chunks[i].positionOffset = positionCount;
+    chunks[i].normalOffset = normalCount;
+    chunks[i].textureCoordsOffset = textureCoordsCount;
+    positionCount += chunks[i].positions.size();
+    normalCount += chunks[i].normals.size();
+    textureCoordsCount += chunks[i].textureCoords.size();
+  }
+
+  positions.resize(positionCount);
+  normals.resize(normalCount);
+  textureCoords.resize(textureCoordsCount);
+
+  parallelFor(chunks.size(), threadCount, [&](GLuint i) {
+    ObjChunk& chunk = chunks[i];
+
+    std::copy(chunk.positions.begin(), chunk.positions.end(),
+              positions.begin() + chunk.positionOffset);
+    std::copy(chunk.normals.begin(), chunk.normals.end(),
+              normals.begin() + chunk.normalOffset);
+    std::copy(chunk.textureCoords.begin(), chunk.textureCoords.end(),
+              textureCoords.begin() + chunk.textureCoordsOffset);
+
+    std::vector<glm::vec3>().swap(chunk.positions);
+    std::vector<glm::vec3>().swap(chunk.normals);
+    std::vector<glm::vec2>().swap(chunk.textureCoords);
+  });
+}
+
+/**
+ * Create a mesh from the given (chunk, group) runs of triangles. Corners
+ * without a normal use the flat normal of their triangle. Returns false if a
+ * corner references an element that does not exist.
+ */
+GLuint ObjLoader::createMesh(
+  const std::vector<std::pair<GLuint, GLuint> >& groups, Mesh& mesh)
+{
+  GLuint cornerCount = 0;
+
+  for (GLuint i = 0; i < groups.size(); i++) {
+    const ObjGroup& group = chunks[groups[i].first].groups[groups[i].second];
+    cornerCount += group.lastCorner - group.firstCorner;
+  }
+
+  mesh.vertices.resize(cornerCount);
+  mesh.indices.resize(cornerCount);
+
+  Vertex* vertex = mesh.vertices.data();
+
+  for (GLuint i = 0; i < groups.size(); i++) {
+    const ObjChunk& chunk = chunks[groups[i].first];
+    const ObjGroup& group = chunk.groups[groups[i].second];
+
+    for (GLuint j = group.firstCorner; j < group.lastCorner; j++) {
+      const ObjCorner& corner = chunk.corners[j];
+      GLint position = corner.position;
+      GLint coords = corner.textureCoords;
+      GLint normal = corner.normal;
+
+      position += (corner.isRelative & 1) ? chunk.positionOffset : 0;
+      coords += (corner.isRelative & 2) ? chunk.textureCoordsOffset : 0;
+      normal += (corner.isRelative & 4) ? chunk.normalOffset : 0;
+
+      if (position < 0 || position >= (GLint)positions.size() ||
+          (coords != OBJ_MISSING &&
+           (coords < 0 || coords >= (GLint)textureCoords.size())) ||
+          (normal != OBJ_MISSING &&
+           (normal < 0 || normal >= (GLint)normals.size()))) {
+        return false;
+      }
+
+      vertex->position = positions[position];
+      vertex->normal = (normal != OBJ_MISSING) ? normals[normal]
+                                               : glm::vec3(0.0f);
+      vertex->textureCoords = (coords != OBJ_MISSING) ? textureCoords[coords]
+                                                      : glm::vec2(0.0f);
+      vertex++;
+    }
+  }
+
+  for (GLuint i = 0; i < cornerCount; i += 3) {
+    Vertex* triangle = &mesh.vertices[i];
+
+    for (GLuint j = 0; j < 3; j++) {
+      mesh.indices[i + j] = i + j;
+    }
+
+    if (triangle[0].normal == glm::vec3(0.0f) ||
+        triangle[1].normal == glm::vec3(0.0f) ||
+        triangle[2].normal == glm::vec3(0.0f)) {
+      glm::vec3 normal = glm::cross(
+        triangle[1].position - triangle[0].position,
+        triangle[2].position - triangle[0].position);
+      GLfloat length = glm::length(normal);
+      normal = (length > 0.0f) ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+
+      for (GLuint j = 0; j < 3; j++) {
+        if (triangle[j].normal == glm::vec3(0.0f)) {
+          triangle[j].normal = normal;
+        }
+      }
+    }
+  }
+
+  return true;
+}
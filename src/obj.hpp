@@ -0,0 +1,88 @@
+/**
+ * [Program description]
+ */
+
+#ifndef OBJ_HEADER
+#define OBJ_HEADER
+
+#include <glm/glm.hpp>
+#include <map>
+#include <string>
+#include <vector>
+#include "mesh.hpp"
+
+#define OBJ_CHUNK_SIZE (1 << 20)
+#define OBJ_MISSING    0x7fffffff
+
+/**
+ * A triangle corner. Negative (relative) indices in the file are stored
+ * relative to the start of the chunk, and flagged so they can be offset once
+ * the number of elements in the preceding chunks is known.
+ */
+struct ObjCorner {
+  GLint position;
+  GLint textureCoords;
+  GLint normal;
+  GLuint isRelative;
+};
+
+/**
+ * A run of triangles sharing an object and material. A group is new if it
+ * was started by an o, g or usemtl record, otherwise it continues the last
+ * group of the previous chunk. The material is unknown if no usemtl record
+ * has been seen in the chunk yet.
+ */
+struct ObjGroup {
+  std::string material;
+  GLuint isNewGroup;
+  GLuint isMaterialKnown;
+  GLuint firstCorner;
+  GLuint lastCorner;
+};
+
+struct ObjChunk {
+  const GLchar* begin;
+  const GLchar* end;
+  GLuint positionOffset;
+  GLuint textureCoordsOffset;
+  GLuint normalOffset;
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> textureCoords;
+  std::vector<ObjCorner> corners;
+  std::vector<ObjGroup> groups;
+  std::vector<std::string> materialLibraries;
+};
+
+struct ObjMaterial {
+  std::vector<std::string> diffuseMaps;
+  std::vector<std::string> specularMaps;
+};
+
+class ObjLoader
+{
+  public:
+    GLuint threadCount;
+    std::string error;
+
+    ObjLoader(std::string modelFilepath = "", GLuint desiredThreadCount = 0);
+    GLuint load(std::vector<Mesh>& meshes);
+
+  private:
+    std::string filepath;
+    std::string directory;
+    std::vector<ObjChunk> chunks;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> textureCoords;
+    std::map<std::string, ObjMaterial> materials;
+
+    GLvoid parseChunk(ObjChunk& chunk);
+    GLvoid parseFace(ObjChunk& chunk, const GLchar* text, const GLchar* end);
+    GLvoid parseMaterials(std::string materialFilepath);
+    GLvoid mergeChunks();
+    GLuint createMesh(const std::vector<std::pair<GLuint, GLuint> >& groups,
+                      Mesh& mesh);
+};
+
+#endif
@@ -0,0 +1,307 @@
+/**
+ * [Program description]
+ */
+
+#include "optimizer.hpp"
+
+#define NO_INDEX 0xffffffff
+
+/**
+ * Score a vertex for the vertex cache optimisation. Vertices used by the
+ * last triangle get a fixed score, otherwise the score decays with the
+ * vertex's position in the cache. Vertices with few remaining triangles are
+ * boosted so that they are finished off rather than left behind.
+ *
+ * This is the scoring function of Tom Forsyth's "Linear-Speed Vertex Cache
+ * Optimisation":
+ * https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+ */
+static GLfloat vertexScore(GLint cachePosition, GLuint liveTriangleCount)
+{
+  GLfloat score = 0.0f;
+
+  if (liveTriangleCount == 0) {
+    return -1.0f;
+  }
+
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      score = 0.75f;
+    } else {
+      score = powf(1.0f - (GLfloat)(cachePosition - 3) /
+                          (VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+  }
+
+  return score + 2.0f / sqrtf((GLfloat)liveTriangleCount);
+}
+
+/**
+ * Constructor to create an optimizer. The cache size is only used to
+ * simulate the post-transform cache when analysing a mesh.
+ */
+MeshOptimizer::MeshOptimizer(GLuint simulatedCacheSize)
+{
+  cacheSize = simulatedCacheSize;
+}
+
+/**
+ * Weld the mesh's identical vertices, reorder its triangles for the vertex
+ * cache, then reorder its vertices for fetch locality.
+ */
+OptimizationReport MeshOptimizer::optimize(Mesh& mesh)
+{
+  OptimizationReport report;
+
+  report.originalVertexCount = mesh.vertices.size();
+  report.original = analyzeVertexCache(mesh);
+
+  weldVertices(mesh);
+  optimizeVertexCache(mesh);
+  optimizeVertexFetch(mesh);
+
+  report.optimizedVertexCount = mesh.vertices.size();
+  report.optimized = analyzeVertexCache(mesh);
+
+  return report;
+}
+
+/**
+ * Merge vertices whose attributes are bitwise identical and remove any
+ * triangles that become degenerate as a result.
+ */
+GLvoid MeshOptimizer::weldVertices(Mesh& mesh)
+{
+  std::vector<Vertex> vertices;
+  std::vector<GLuint> remap(mesh.vertices.size());
+  std::vector<GLuint> table;
+  size_t tableSize = 1;
+  size_t indexCount = 0;
+
+  while (tableSize < mesh.vertices.size() * 2) {
+    tableSize *= 2;
+  }
+
+  table.assign(tableSize, NO_INDEX);
+  vertices.reserve(mesh.vertices.size());
+
+  // Find each vertex in an open addressing hash table of unique vertices.
+  for (GLuint i = 0; i < mesh.vertices.size(); i++) {
+    const Vertex& vertex = mesh.vertices[i];
+    size_t slot = hashBytes(&vertex, sizeof(Vertex)) & (tableSize - 1);
+
+    while (table[slot] != NO_INDEX &&
+           memcmp(&vertices[table[slot]], &vertex, sizeof(Vertex)) != 0) {
+      slot = (slot + 1) & (tableSize - 1);
+    }
+
+    if (table[slot] == NO_INDEX) {
+      table[slot] = vertices.size();
+      vertices.push_back(vertex);
+    }
+
+    remap[i] = table[slot];
+  }
+
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    GLuint a = remap[mesh.indices[i]];
+    GLuint b = remap[mesh.indices[i + 1]];
+    GLuint c = remap[mesh.indices[i + 2]];
+
+    if (a != b && b != c && c != a) {
+      mesh.indices[indexCount++] = a;
+      mesh.indices[indexCount++] = b;
+      mesh.indices[indexCount++] = c;
+    }
+  }
+
+  mesh.indices.resize(indexCount);
+  mesh.vertices.swap(vertices);
+}
+
+/**
+ * Reorder the mesh's triangles so that consecutive triangles reuse recently
+ * transformed vertices, using Tom Forsyth's greedy algorithm with a simulated
+ * LRU cache.
+ */
+GLvoid MeshOptimizer::optimizeVertexCache(Mesh& mesh)
+{
+  GLuint vertexCount = mesh.vertices.size();
+  GLuint triangleCount = mesh.indices.size() / 3;
+  std::vector<GLuint> liveTriangleCounts(vertexCount, 0);
+  std::vector<GLuint> adjacencyOffsets(vertexCount + 1, 0);
+  std::vector<GLuint> adjacency(triangleCount * 3);
+  std::vector<GLint> cachePositions(vertexCount, -1);
+  std::vector<GLfloat> vertexScores(vertexCount);
+  std::vector<GLfloat> triangleScores(triangleCount);
+  std::vector<GLuint> isTriangleAdded(triangleCount, false);
+  std::vector<GLuint> indices;
+  std::vector<GLuint> cache, newCache;
+  GLuint bestTriangle = NO_INDEX;
+  GLuint nextTriangle = 0;
+
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Build the list of triangles that use each vertex.
+  for (GLuint i = 0; i < triangleCount * 3; i++) {
+    liveTriangleCounts[mesh.indices[i]]++;
+  }
+
+  for (GLuint i = 0; i < vertexCount; i++) {
+    adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangleCounts[i];
+    vertexScores[i] = vertexScore(-1, liveTriangleCounts[i]);
+  }
+
+  std::vector<GLuint> adjacencyCounts(vertexCount, 0);
+
+  for (GLuint i = 0; i < triangleCount * 3; i++) {
+    GLuint vertex = mesh.indices[i];
+    adjacency[adjacencyOffsets[vertex] + adjacencyCounts[vertex]++] = i / 3;
+  }
+
+  for (GLuint i = 0; i < triangleCount; i++) {
+    triangleScores[i] = vertexScores[mesh.indices[i * 3]] +
+                        vertexScores[mesh.indices[i * 3 + 1]] +
+                        vertexScores[mesh.indices[i * 3 + 2]];
+
+    if (bestTriangle == NO_INDEX ||
+        triangleScores[i] > triangleScores[bestTriangle]) {
+      bestTriangle = i;
+    }
+  }
+
+  indices.reserve(triangleCount * 3);
+
+  while (indices.size() < triangleCount * 3) {
+    // If no cached vertex has any triangles left, start from the next
+    // triangle that has not been added yet.
+    if (bestTriangle == NO_INDEX) {
+      while (isTriangleAdded[nextTriangle]) {
+        nextTriangle++;
+      }
+
+      bestTriangle = nextTriangle;
+    }
+
+    const GLuint* triangle = &mesh.indices[bestTriangle * 3];
+    isTriangleAdded[bestTriangle] = true;
+    newCache.assign(triangle, triangle + 3);
+
+    // Remove the triangle from its vertices' lists of live triangles.
+    for (GLuint i = 0; i < 3; i++) {
+      GLuint vertex = triangle[i];
+      GLuint* begin = &adjacency[adjacencyOffsets[vertex]];
+      GLuint* end = begin + liveTriangleCounts[vertex];
+
+      indices.push_back(vertex);
+      *std::find(begin, end, bestTriangle) = end[-1];
+      liveTriangleCounts[vertex]--;
+    }
+
+    // Move the triangle's vertices to the front of the cache.
+    for (GLuint i = 0; i < cache.size(); i++) {
+      if (cache[i] != triangle[0] && cache[i] != triangle[1] &&
+          cache[i] != triangle[2]) {
+        newCache.push_back(cache[i]);
+      }
+    }
+
+    cache.swap(newCache);
+
+    for (GLuint i = 0; i < cache.size(); i++) {
+      GLuint vertex = cache[i];
+      cachePositions[vertex] = (i < VERTEX_CACHE_SIZE) ? (GLint)i : -1;
+      vertexScores[vertex] = vertexScore(cachePositions[vertex],
+                                         liveTriangleCounts[vertex]);
+    }
+
+    // Rescore the live triangles of every cached (or just evicted) vertex
+    // and pick the best one to add next.
+    bestTriangle = NO_INDEX;
+
+    for (GLuint i = 0; i < cache.size(); i++) {
+      GLuint vertex = cache[i];
+      GLuint* adjacent = &adjacency[adjacencyOffsets[vertex]];
+
+      for (GLuint j = 0; j < liveTriangleCounts[vertex]; j++) {
+        GLuint candidate = adjacent[j];
+        const GLuint* corners = &mesh.indices[candidate * 3];
+
+        triangleScores[candidate] = vertexScores[corners[0]] +
+                                    vertexScores[corners[1]] +
+                                    vertexScores[corners[2]];
+
+        if (bestTriangle == NO_INDEX ||
+            triangleScores[candidate] > triangleScores[bestTriangle]) {
+          bestTriangle = candidate;
+        }
+      }
+    }
+
+    if (cache.size() > VERTEX_CACHE_SIZE) {
+      cache.resize(VERTEX_CACHE_SIZE);
+    }
+  }
+
+  mesh.indices.swap(indices);
+}
+
+/**
+ * Reorder the mesh's vertices into the order they are first referenced by its
+ * indices, so vertex fetches walk through memory mostly sequentially. Any
+ * unreferenced vertices are removed.
+ */
+GLvoid MeshOptimizer::optimizeVertexFetch(Mesh& mesh)
+{
+  std::vector<GLuint> remap(mesh.vertices.size(), NO_INDEX);
+  std::vector<Vertex> vertices;
+
+  vertices.reserve(mesh.vertices.size());
+
+  for (GLuint i = 0; i < mesh.indices.size(); i++) {
+    GLuint& index = mesh.indices[i];
+
+    if (remap[index] == NO_INDEX) {
+      remap[index] = vertices.size();
+      vertices.push_back(mesh.vertices[index]);
+    }
+
+    index = remap[index];
+  }
+
+  mesh.vertices.swap(vertices);
+}
+
+/**
+ * Simulate a FIFO post-transform cache to measure how many vertices would be
+ * transformed when drawing the mesh.
+ */
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const Mesh& mesh)
+{
+  VertexCacheStatistics statistics;
+  std::vector<GLuint> insertionTimes(mesh.vertices.size(), NO_INDEX);
+  GLuint misses = 0;
+  GLuint uniqueVertexCount = 0;
+  GLuint triangleCount = mesh.indices.size() / 3;
+
+  for (GLuint i = 0; i < triangleCount * 3; i++) {
+    GLuint& insertionTime = insertionTimes[mesh.indices[i]];
+
+    if (insertionTime == NO_INDEX) {
+      uniqueVertexCount++;
+    }
+
+    // A vertex is cached if fewer than cacheSize vertices were added since.
+    if (insertionTime == NO_INDEX || misses - insertionTime >= cacheSize) {
+      insertionTime = misses++;
+    }
+  }
+
+  statistics.acmr = triangleCount ? (GLfloat)misses / triangleCount : 0.0f;
+  statistics.atvr = uniqueVertexCount ?
+                    (GLfloat)misses / uniqueVertexCount : 0.0f;
+
+  return statistics;
+}
@@ -0,0 +1,39 @@
+/**
+ * [Program description]
+ */
+
+#ifndef OPTIMIZER_HEADER
+#define OPTIMIZER_HEADER
+
+#include <vector>
+#include "mesh.hpp"
+
+#define VERTEX_CACHE_SIZE    32
+#define SIMULATED_CACHE_SIZE 16
+
+struct VertexCacheStatistics {
+  GLfloat acmr; // average cache misses (transformed vertices) per triangle
+  GLfloat atvr; // average times each unique vertex is transformed
+};
+
+struct OptimizationReport {
+  GLuint originalVertexCount;
+  GLuint optimizedVertexCount;
+  VertexCacheStatistics original;
+  VertexCacheStatistics optimized;
+};
+
+class MeshOptimizer
+{
+  public:
+    GLuint cacheSize;
+
+    MeshOptimizer(GLuint simulatedCacheSize = SIMULATED_CACHE_SIZE);
+    OptimizationReport optimize(Mesh& mesh);
+    GLvoid weldVertices(Mesh& mesh);
+    GLvoid optimizeVertexCache(Mesh& mesh);
+    GLvoid optimizeVertexFetch(Mesh& mesh);
+    VertexCacheStatistics analyzeVertexCache(const Mesh& mesh);
+};
+
+#endif
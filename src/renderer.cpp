@@ -0,0 +1,382 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+
+#include "renderer.hpp"
+
+#define NO_STATE 0xffffffff
+
+/**
+ * Constructor to create an empty render queue. Every pass starts with the
+ * default state: depth testing on, no culling, and stencil writes enabled.
+ */
+RenderQueue::RenderQueue()
+{
+  PassState defaultState = { true, false, GL_ALWAYS, 0xFF };
+
+  for (GLuint i = 0; i < MAX_RENDER_PASSES; i++) {
+    passStates[i] = defaultState;
+  }
+
+  memset(&statistics, 0, sizeof(RenderStatistics));
+  isGpuCullingEnabled = false;
+  cullShader = NULL;
+  lodScale = 0.0f;
+  lodPixelError = 1.0f;
+  isMeshletCullingEnabled = false;
+}
+
+GLvoid RenderQueue::setPassState(GLuint pass, PassState state)
+{
+  passStates[pass] = state;
+}
+
+const PassState& RenderQueue::passState(GLuint pass) const
+{
+  return passStates[pass];
+}
+
+/**
+ * Remove every draw and transform from the queue and reset the statistics,
+ * ready for a new frame viewed through the given view matrix.
+ */
+GLvoid RenderQueue::clear(const glm::mat4& view)
+{
+  commands.clear();
+  transforms.clear();
+  rangeCounts.clear();
+  rangeOffsets.clear();
+  rangeBaseVertices.clear();
+  viewMatrix = view;
+  memset(&statistics, 0, sizeof(RenderStatistics));
+}
+
+const glm::mat4& RenderQueue::view() const
+{
+  return viewMatrix;
+}
+
+/**
+ * Add a model transform for the frame and return its index, to be passed to
+ * submit for each draw that uses it.
+ */
+GLuint RenderQueue::addTransform(const glm::mat4& transform)
+{
+  transforms.push_back(transform);
+
+  return transforms.size() - 1;
+}
+
+/**
+ * Add a draw of the given mesh to the queue. The center (in model space) is
+ * used to sort draws with the same state from front to back, and to pick the
+ * coarsest level of detail whose error projects to at most lodPixelError
+ * pixels, if the LOD scale (pixels per unit at a distance of one) is set. If
+ * a GPU culler is given, the draw is instead the given batch of the culler's
+ * draws left by the cull in the given slot, with the mesh's textures. Draws
+ * by programs without materials ignore the mesh's textures, so they are
+ * sorted by vertex array alone.
+ */
+GLvoid RenderQueue::submit(GLuint pass, const Shader& shader, GLuint vao,
+                           GLuint transform, const Mesh& mesh,
+                           glm::vec3 center, const GpuCuller* culler,
+                           GLuint cullSlot, GLuint batch)
+{
+  DrawCommand command;
+  glm::vec4 position = viewMatrix * transforms[transform] *
+                       glm::vec4(center, 1.0f);
+  GLfloat depth = std::max(-position.z, 0.0f);
+  GLuint depthBits, diffuseID = 0, specularID = 0;
+
+  // The bits of a positive float sort in the same order as its value.
+  memcpy(&depthBits, &depth, sizeof(GLuint));
+
+  for (GLuint i = 0; shader.usesMaterials() && i < mesh.textures.size();
+       i++) {
+    if (mesh.textures[i].type == "diffuse" && !diffuseID) {
+      diffuseID = mesh.textures[i].id;
+    } else if (mesh.textures[i].type == "specular" && !specularID) {
+      specularID = mesh.textures[i].id;
+    }
+  }
+
+  command.key = ((GLuint64)pass << PASS_KEY_SHIFT) |
+                ((GLuint64)(shader.id & 0xFF) << PROGRAM_KEY_SHIFT) |
+                ((GLuint64)(diffuseID & 0xFFF) << (MATERIAL_KEY_SHIFT + 12)) |
+                ((GLuint64)(specularID & 0xFFF) << MATERIAL_KEY_SHIFT) |
+                ((GLuint64)(vao & 0xFF) << VAO_KEY_SHIFT) |
+                (depthBits >> 11);
+  command.pass = pass;
+  command.vao = vao;
+  command.transform = transform;
+  command.shader = &shader;
+  command.mesh = &mesh;
+  command.culler = culler;
+  command.cullSlot = cullSlot;
+  command.batch = batch;
+  command.instanceCount = 1;
+  command.lod = 0;
+  command.firstRange = command.rangeCount = 0;
+
+  if (lodScale > 0.0f && !culler && !mesh.lods.empty()) {
+    GLfloat distance = std::max(glm::length(glm::vec3(position)), 1e-4f);
+    GLfloat scale = glm::length(glm::vec3(transforms[transform][0]));
+
+    command.lod = mesh.selectLod(lodScale * scale * mesh.bounds.radius /
+                                 distance, lodPixelError);
+  }
+
+  commands.push_back(command);
+}
+
+/**
+ * Add an instanced draw of the given mesh to the queue, which draws the given
+ * number of instances from the vertex array's instance attributes. The
+ * instances are spread out, so they are drawn in full detail.
+ */
+GLvoid RenderQueue::submitInstanced(GLuint pass, const Shader& shader,
+                                    GLuint vao, GLuint transform,
+                                    const Mesh& mesh, glm::vec3 center,
+                                    GLuint instanceCount)
+{
+  submit(pass, shader, vao, transform, mesh, center);
+  commands.back().instanceCount = instanceCount;
+  commands.back().lod = 0;
+}
+
+/**
+ * Add a draw of the given ranges of the mesh's indices to the queue, drawn
+ * with one multi-draw. If the mesh is far enough away for a coarser level of
+ * detail, that level is drawn in full instead.
+ */
+GLvoid RenderQueue::submitRanges(GLuint pass, const Shader& shader,
+                                 GLuint vao, GLuint transform,
+                                 const Mesh& mesh, glm::vec3 center,
+                                 const std::vector<IndexRange>& ranges)
+{
+  submit(pass, shader, vao, transform, mesh, center);
+
+  if (commands.back().lod) {
+    return;
+  }
+
+  commands.back().firstRange = rangeCounts.size();
+  commands.back().rangeCount = ranges.size();
+
+  for (GLuint i = 0; i < ranges.size(); i++) {
+    rangeCounts.push_back(ranges[i].indexCount);
+    rangeOffsets.push_back((GLvoid*)((mesh.firstIndex + ranges[i].firstIndex) *
+                                     sizeof(GLuint)));
+    rangeBaseVertices.push_back(mesh.baseVertex);
+  }
+}
+
+/**
+ * Sort the queued draws by their keys and draw them, only changing the pass
+ * state, program, model transform, vertex array, textures and texture layers
+ * when they differ from the previous draw. Programs without materials get no
+ * textures or layers, and programs with a normal matrix get it with the
+ * transform, so it is not inverted per vertex. Each pass is timed on the GPU
+ * if the timer is enabled.
+ */
+GLvoid RenderQueue::execute()
+{
+  GLuint currentPass = NO_STATE, currentProgram = NO_STATE;
+  GLuint currentVao = NO_STATE, currentTransform = NO_STATE;
+  GLuint currentVertexTexture = NO_STATE, currentBaseVertex = NO_STATE;
+  glm::ivec2 currentLayers(-1), layers;
+  glm::mat3 normalMatrix;
+  GLuint boundTextures[MAX_TEXTURE_UNITS];
+  PassState defaultState = { true, false, GL_ALWAYS, 0xFF };
+
+  std::fill(boundTextures, boundTextures + MAX_TEXTURE_UNITS, NO_STATE);
+  resetInstanceAttributes();
+
+  std::sort(commands.begin(), commands.end(),
+            [](const DrawCommand& a, const DrawCommand& b) {
+              return a.key < b.key;
+            });
+
+  for (GLuint i = 0; i < commands.size(); i++) {
+    const DrawCommand& command = commands[i];
+
+    if (command.pass != currentPass) {
+      gpuTimer.begin(command.pass);
+      applyPassState(passStates[command.pass]);
+      currentPass = command.pass;
+      statistics.passChanges++;
+    }
+
+    if (command.shader->id != currentProgram) {
+      glUseProgram(command.shader->id);
+      currentProgram = command.shader->id;
+      currentTransform = currentBaseVertex = NO_STATE;
+      currentLayers = glm::ivec2(-1);
+      statistics.programChanges++;
+    }
+
+    if (command.transform != currentTransform) {
+      glUniformMatrix4fv(command.shader->modelLocation, 1, GL_FALSE,
+                         &transforms[command.transform][0][0]);
+
+      if (command.shader->normalMatrixLocation >= 0) {
+        normalMatrix = glm::transpose(glm::inverse(glm::mat3(
+                       viewMatrix * transforms[command.transform])));
+        glUniformMatrix3fv(command.shader->normalMatrixLocation, 1,
+                           GL_FALSE, &normalMatrix[0][0]);
+      }
+
+      currentTransform = command.transform;
+      statistics.transformChanges++;
+    }
+
+    if (command.vao != currentVao) {
+      glBindVertexArray(command.vao);
+      currentVao = command.vao;
+      statistics.vaoChanges++;
+    }
+
+    if (command.shader->usesMaterials()) {
+      statistics.textureChanges +=
+        command.mesh->bindTextures(boundTextures);
+    }
+
+    if (command.culler) {
+      command.culler->draw(command.cullSlot, command.batch);
+      statistics.drawCount++;
+      continue;
+    }
+
+    // The culler's vertex arrays read the layers from a buffer instead.
+    if (command.shader->usesMaterials()) {
+      layers = command.mesh->textureLayers();
+
+      if (layers != currentLayers) {
+        glVertexAttribI2i(MATERIAL_LAYERS_ATTRIBUTE, layers.x, layers.y);
+        currentLayers = layers;
+        statistics.layerChanges++;
+      }
+    }
+
+    if (command.shader->pulledPrimitive) {
+      if (command.mesh->vertexTexture != currentVertexTexture) {
+        glActiveTexture(GL_TEXTURE0 + VERTEX_BUFFER_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, command.mesh->vertexTexture);
+        glActiveTexture(GL_TEXTURE0 + INDEX_BUFFER_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, command.mesh->indexTexture);
+        glActiveTexture(GL_TEXTURE0);
+        currentVertexTexture = command.mesh->vertexTexture;
+        statistics.textureChanges += 2;
+      }
+
+      if (command.mesh->baseVertex != currentBaseVertex) {
+        glUniform1i(command.shader->baseVertexLocation,
+                    command.mesh->baseVertex);
+        currentBaseVertex = command.mesh->baseVertex;
+      }
+
+      drawPulled(command);
+      continue;
+    }
+
+    if (command.rangeCount) {
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES,
+                                    &rangeCounts[command.firstRange],
+                                    GL_UNSIGNED_INT,
+                                    &rangeOffsets[command.firstRange],
+                                    command.rangeCount,
+                                    &rangeBaseVertices[command.firstRange]);
+      statistics.drawCount++;
+
+      for (GLuint j = 0; j < command.rangeCount; j++) {
+        statistics.triangleCount += rangeCounts[command.firstRange + j] / 3;
+      }
+
+      continue;
+    }
+
+    command.mesh->drawElements(command.instanceCount, command.lod);
+    statistics.drawCount++;
+    statistics.triangleCount += (GLuint64)command.instanceCount *
+                                command.mesh->lod(command.lod).indexCount / 3;
+  }
+
+  glBindVertexArray(0);
+  applyPassState(defaultState);
+  gpuTimer.endFrame();
+}
+
+/**
+ * Draw a command whose program fetches its own vertices, without an index
+ * buffer. The vertices drawn stand for the indices of the mesh's ranges (or
+ * its level of detail) in the index buffer, one vertex each for triangles and
+ * two (a line from the vertex along its normal) for lines.
+ */
+GLvoid RenderQueue::drawPulled(const DrawCommand& command)
+{
+  const Mesh& mesh = *command.mesh;
+  GLenum primitive = command.shader->pulledPrimitive;
+  GLuint verticesPerIndex = (primitive == GL_LINES) ? 2 : 1;
+  MeshLod range = mesh.lod(command.lod);
+
+  if (command.rangeCount) {
+    pulledFirsts.clear();
+    pulledCounts.clear();
+
+    for (GLuint i = 0; i < command.rangeCount; i++) {
+      GLuint index = command.firstRange + i;
+
+      pulledFirsts.push_back((GLintptr)rangeOffsets[index] / sizeof(GLuint) *
+                             verticesPerIndex);
+      pulledCounts.push_back(rangeCounts[index] * verticesPerIndex);
+      statistics.triangleCount += rangeCounts[index] / 3;
+    }
+
+    glMultiDrawArrays(primitive, pulledFirsts.data(), pulledCounts.data(),
+                      command.rangeCount);
+    statistics.drawCount++;
+    return;
+  }
+
+  glDrawArraysInstanced(primitive, (mesh.firstIndex + range.firstIndex) *
+                        verticesPerIndex, range.indexCount * verticesPerIndex,
+                        command.instanceCount);
+  statistics.drawCount++;
+  statistics.triangleCount += (GLuint64)command.instanceCount *
+                              range.indexCount / 3;
+}
+
+/**
+ * Set the instance attributes read by vertex arrays without instances to a
+ * single untinted instance with no transform of its own.
+ */
+GLvoid RenderQueue::resetInstanceAttributes()
+{
+  glm::mat4 identity(1.0f);
+
+  for (GLuint i = 0; i < 4; i++) {
+    glVertexAttrib4fv(INSTANCE_TRANSFORM_ATTRIBUTE + i, &identity[i][0]);
+  }
+
+  glVertexAttrib4f(INSTANCE_TINT_ATTRIBUTE, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+GLvoid RenderQueue::applyPassState(const PassState& state)
+{
+  if (state.isDepthTestEnabled) {
+    glEnable(GL_DEPTH_TEST);
+  } else {
+    glDisable(GL_DEPTH_TEST);
+  }
+
+  if (state.isCullingEnabled) {
+    glEnable(GL_CULL_FACE);
+  } else {
+    glDisable(GL_CULL_FACE);
+  }
+
+  glStencilFunc(state.stencilFunction, 1, 0xFF);
+  glStencilMask(state.stencilMask);
+}
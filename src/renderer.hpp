@@ -0,0 +1,121 @@
+/**
+ * [Program description]
+ */
+
+#ifndef RENDERER_HEADER
+#define RENDERER_HEADER
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "gpuculler.hpp"
+#include "gputimer.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+
+#define MAX_RENDER_PASSES 16
+#define MAX_TEXTURE_UNITS (2 * MAX_TEXTURES_PER_TYPE)
+
+/**
+ * The sort key of a draw, from the most to the least significant bits:
+ *   pass     (4 bits)  - passes are drawn in order
+ *   program  (8 bits)
+ *   material (24 bits) - the diffuse and specular texture IDs
+ *   VAO      (8 bits)
+ *   depth    (20 bits) - front to back within the same state
+ */
+#define PASS_KEY_SHIFT     60
+#define PROGRAM_KEY_SHIFT  52
+#define MATERIAL_KEY_SHIFT 28
+#define VAO_KEY_SHIFT      20
+
+struct PassState {
+  GLuint isDepthTestEnabled;
+  GLuint isCullingEnabled;
+  GLenum stencilFunction;
+  GLuint stencilMask;
+};
+
+/**
+ * A range of a mesh's indices, relative to the mesh's first index.
+ */
+struct IndexRange {
+  GLuint firstIndex;
+  GLuint indexCount;
+};
+
+struct DrawCommand {
+  GLuint64 key;
+  GLuint pass;
+  GLuint vao;
+  GLuint transform;
+  const Shader* shader;
+  const Mesh* mesh;
+  const GpuCuller* culler;
+  GLuint cullSlot;
+  GLuint batch;
+  GLuint instanceCount;
+  GLuint lod;
+  GLuint firstRange;
+  GLuint rangeCount;
+};
+
+struct RenderStatistics {
+  GLuint drawCount;
+  GLuint passChanges;
+  GLuint programChanges;
+  GLuint textureChanges;
+  GLuint vaoChanges;
+  GLuint transformChanges;
+  GLuint layerChanges;
+  GLuint64 triangleCount;
+  GLuint visibleMeshCount;
+  GLuint culledMeshCount;
+  GLuint culledMeshletCount;
+};
+
+class RenderQueue
+{
+  public:
+    RenderStatistics statistics;
+    GpuTimer gpuTimer;
+    GLuint isGpuCullingEnabled;
+    const Shader* cullShader;
+    GLfloat lodScale;
+    GLfloat lodPixelError;
+    GLuint isMeshletCullingEnabled;
+
+    RenderQueue();
+    GLvoid setPassState(GLuint pass, PassState state);
+    const PassState& passState(GLuint pass) const;
+    GLvoid clear(const glm::mat4& view);
+    const glm::mat4& view() const;
+    GLuint addTransform(const glm::mat4& transform);
+    GLvoid submit(GLuint pass, const Shader& shader, GLuint vao,
+                  GLuint transform, const Mesh& mesh, glm::vec3 center,
+                  const GpuCuller* culler = NULL, GLuint cullSlot = 0,
+                  GLuint batch = 0);
+    GLvoid submitInstanced(GLuint pass, const Shader& shader, GLuint vao,
+                           GLuint transform, const Mesh& mesh,
+                           glm::vec3 center, GLuint instanceCount);
+    GLvoid submitRanges(GLuint pass, const Shader& shader, GLuint vao,
+                        GLuint transform, const Mesh& mesh, glm::vec3 center,
+                        const std::vector<IndexRange>& ranges);
+    GLvoid execute();
+
+  private:
+    std::vector<DrawCommand> commands;
+    std::vector<glm::mat4> transforms;
+    std::vector<GLsizei> rangeCounts;
+    std::vector<GLvoid*> rangeOffsets;
+    std::vector<GLint> rangeBaseVertices;
+    std::vector<GLint> pulledFirsts;
+    std::vector<GLsizei> pulledCounts;
+    PassState passStates[MAX_RENDER_PASSES];
+    glm::mat4 viewMatrix;
+
+    GLvoid applyPassState(const PassState& state);
+    GLvoid drawPulled(const DrawCommand& command);
+    GLvoid resetInstanceAttributes();
+};
+
+#endif
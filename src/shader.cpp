@@ -2,105 +2,520 @@
  * [Program description]
  */
 
+#include "mesh.hpp"
 #include "shader.hpp"
 
 Shader::Shader(std::string vertexFile, std::string fragmentFile,
                std::string geometryFile)
 {
+  id = 0;
+  isCacheEnabled = false;
+  pulledPrimitive = 0;
+  isPositionStreamUsed = false;
+  isLineDrawn = false;
+  modelLocation = normalMatrixLocation = baseVertexLocation = -1;
   vertexShaderFile = vertexFile;
   geometryShaderFile = geometryFile;
   fragmentShaderFile = fragmentFile;
+  vertexShaderID = 0;
+  geometryShaderID = 0;
+  fragmentShaderID = 0;
+  binaryKey = 0;
+  isMaterialUsed = false;
 }
 
 /**
  * Read and create the shader. This involves retrieving the
  * shader source code from the given vertex/geometry/fragment files and
- * compiling the code, then linking them into a shader program.
+ * compiling the code, then linking them into a shader program. A program
+ * with only a .comp file is a compute program.
  */
 GLvoid Shader::load()
 {
-  GLint compileStatus;
-  GLchar compileLog[LOG_MSG_LENGTH];
-  GLuint vertexShaderID, fragmentShaderID, geometryShaderID = 0;
-  GLuint isGeometryShaderIncluded = !geometryShaderFile.empty();
+  submit();
+  finish();
+}
 
-  // Vertex shader
-  const GLchar* vertexShaderSource = readFile(vertexShaderFile);
-  vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShaderID, 1, &vertexShaderSource, NULL);
-  glCompileShader(vertexShaderID);
-  glGetShaderiv(vertexShaderID, GL_COMPILE_STATUS, &compileStatus);
+/**
+ * Start creating the shader program without waiting for the driver. Every
+ * stage is compiled and the program is linked, but neither status is queried
+ * until finish is called, so several programs can be compiled in parallel by
+ * drivers that support it. If caching is enabled, the linked program binary
+ * is reused from the last run when the sources and driver have not changed.
+ */
+GLvoid Shader::submit()
+{
+  TraceZone zone("Shader::submit");
+  std::string vertexSource = readFile(vertexShaderFile);
+  std::string fragmentSource, geometrySource;
 
-  if (compileStatus != GL_TRUE) {
-    glGetShaderInfoLog(vertexShaderID, LOG_MSG_LENGTH, NULL, compileLog);
-    fprintf(stderr, "\nVertex compilation error (ID: %d) in file: %s\n%s\n",
-            vertexShaderID, vertexShaderFile.c_str(), compileLog);
+  zone.addArgument("file", vertexShaderFile);
 
-    exit(EXIT_FAILURE);
+  if (!fragmentShaderFile.empty()) {
+    fragmentSource = readFile(fragmentShaderFile);
   }
 
-  // Fragment shader
-  const GLchar* fragmentShaderSource = readFile(fragmentShaderFile);
-  fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShaderID, 1, &fragmentShaderSource, NULL);
-  glCompileShader(fragmentShaderID);
-  glGetShaderiv(fragmentShaderID, GL_COMPILE_STATUS, &compileStatus);
+  if (!geometryShaderFile.empty()) {
+    geometrySource = readFile(geometryShaderFile);
+  }
 
-  if (compileStatus != GL_TRUE) {
-    glGetShaderInfoLog(fragmentShaderID, LOG_MSG_LENGTH, NULL, compileLog);
-    fprintf(stderr, "\nFragment compilation error (ID: %d) in file: %s\n%s\n",
-            fragmentShaderID, fragmentShaderFile.c_str(), compileLog);
+  if (isCacheEnabled) {
+    binaryKey = cacheKey(vertexSource, geometrySource, fragmentSource);
 
-    exit(EXIT_FAILURE);
+    if (loadBinary(binaryKey)) {
+      zone.addArgument("cache", "hit");
+      return;
+    }
   }
 
-  // Geometry shader
-  if (isGeometryShaderIncluded) {
-    const GLchar* geometryShaderSource = readFile(geometryShaderFile);
-    geometryShaderID = glCreateShader(GL_GEOMETRY_SHADER);
-    glShaderSource(geometryShaderID, 1, &geometryShaderSource, NULL);
-    glCompileShader(geometryShaderID);
-    glGetShaderiv(geometryShaderID, GL_COMPILE_STATUS, &compileStatus);
-
-    if (compileStatus != GL_TRUE) {
-      glGetShaderInfoLog(geometryShaderID, LOG_MSG_LENGTH, NULL, compileLog);
-      fprintf(stderr, "\nGeometry compilation error (ID: %d) in file: %s\n%s\n",
-              geometryShaderID, geometryShaderFile.c_str(), compileLog);
+  // The compute shader takes the place of the vertex shader.
+  if (isComputeShader()) {
+    vertexShaderID = compile(GL_COMPUTE_SHADER, vertexSource,
+                             vertexShaderFile);
+  } else {
+    vertexShaderID = compile(GL_VERTEX_SHADER, vertexSource,
+                             vertexShaderFile);
+    fragmentShaderID = compile(GL_FRAGMENT_SHADER, fragmentSource,
+                               fragmentShaderFile);
+  }
 
-      exit(EXIT_FAILURE);
-    }
+  if (!geometrySource.empty()) {
+    geometryShaderID = compile(GL_GEOMETRY_SHADER, geometrySource,
+                               geometryShaderFile);
   }
 
-  // Create and compile the shader program.
   id = glCreateProgram();
   glAttachShader(id, vertexShaderID);
-  glAttachShader(id, fragmentShaderID);
 
-  if (isGeometryShaderIncluded) {
+  if (fragmentShaderID) {
+    glAttachShader(id, fragmentShaderID);
+  }
+
+  if (geometryShaderID) {
     glAttachShader(id, geometryShaderID);
   }
 
-  glLinkProgram(id);
-  glGetProgramiv(id, GL_LINK_STATUS, &compileStatus);
+  if (isCacheEnabled) {
+    glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
 
-  if (compileStatus != GL_TRUE) {
-    glGetProgramInfoLog(id, LOG_MSG_LENGTH, NULL, compileLog);
-    fprintf(stderr, "\nShader program compilation error (ID: %d):\n%s\n",
-           id, compileLog);
+  glLinkProgram(id);
+}
 
+/**
+ * Wait for the program submitted by submit to link, and exit if it failed.
+ */
+GLvoid Shader::finish()
+{
+  if (!completeLink()) {
     exit(EXIT_FAILURE);
   }
+}
+
+/**
+ * Create the program again from its (changed) files. The old program is kept,
+ * and still used, if the new one fails to compile or link. Returns whether
+ * the program was replaced.
+ */
+GLuint Shader::reload()
+{
+  TraceZone zone("Shader::reload");
+  GLuint oldID = id;
+
+  submit();
+
+  if (!completeLink()) {
+    glDeleteProgram(id);
+    id = oldID;
+
+    return false;
+  }
+
+  glDeleteProgram(oldID);
+
+  return true;
+}
+
+/**
+ * Return whether the given file is one of the program's shader stages.
+ */
+GLuint Shader::usesFile(const std::string& file) const
+{
+  return file == vertexShaderFile || file == geometryShaderFile ||
+         file == fragmentShaderFile;
+}
+
+/**
+ * Return the file of every shader stage in the program.
+ */
+std::vector<std::string> Shader::files() const
+{
+  std::vector<std::string> stageFiles;
+
+  stageFiles.push_back(vertexShaderFile);
+
+  if (!fragmentShaderFile.empty()) {
+    stageFiles.push_back(fragmentShaderFile);
+  }
+
+  if (!geometryShaderFile.empty()) {
+    stageFiles.push_back(geometryShaderFile);
+  }
+
+  return stageFiles;
+}
+
+/**
+ * Wait for the submitted program to link and check it for errors. A failed
+ * link is reported for the first stage that failed to compile, or for the
+ * program if every stage compiled. Returns whether the program linked.
+ */
+GLuint Shader::completeLink()
+{
+  TraceZone zone("Shader::completeLink");
+  GLint linkStatus;
+  GLchar linkLog[LOG_MSG_LENGTH];
+  GLuint isCompiled = true;
+  GLuint stageIDs[] = { vertexShaderID, fragmentShaderID, geometryShaderID };
+  const std::string* stageFiles[] = {
+    &vertexShaderFile, &fragmentShaderFile, &geometryShaderFile
+  };
+  const GLchar* stageNames[] = {
+    isComputeShader() ? "Compute" : "Vertex", "Fragment", "Geometry"
+  };
+
+  zone.addArgument("file", vertexShaderFile);
+
+  // Programs loaded from a cached binary are already linked.
+  if (!vertexShaderID) {
+    reflectUniforms();
+    return true;
+  }
+
+  glGetProgramiv(id, GL_LINK_STATUS, &linkStatus);
+
+  for (GLuint i = 0; linkStatus != GL_TRUE && isCompiled && i < 3; i++) {
+    if (stageIDs[i]) {
+      isCompiled = checkCompileStatus(stageIDs[i], *stageFiles[i],
+                                      stageNames[i]);
+    }
+  }
+
+  if (linkStatus != GL_TRUE && isCompiled) {
+    glGetProgramInfoLog(id, LOG_MSG_LENGTH, NULL, linkLog);
+    fprintf(stderr, "\nShader program compilation error (ID: %d):\n%s\n",
+           id, linkLog);
+  }
 
   // Delete the shaders as they are now linked to the program.
-  glDetachShader(id, vertexShaderID);
-  glDetachShader(id, fragmentShaderID);
-  glDeleteShader(vertexShaderID);
-  glDeleteShader(fragmentShaderID);
+  for (GLuint i = 0; i < 3; i++) {
+    if (stageIDs[i]) {
+      glDetachShader(id, stageIDs[i]);
+      glDeleteShader(stageIDs[i]);
+    }
+  }
+
+  vertexShaderID = 0;
+  geometryShaderID = 0;
+  fragmentShaderID = 0;
 
-  if (isGeometryShaderIncluded) {
-    glDetachShader(id, geometryShaderID);
-    glDeleteShader(geometryShaderID);
+  if (linkStatus != GL_TRUE) {
+    return false;
   }
+
+  if (isCacheEnabled) {
+    saveBinary(binaryKey);
+  }
+
+  reflectUniforms();
+
+  return true;
+}
+
+/**
+ * Return the key of the program binary: a hash of every shader source and the
+ * vendor, renderer and version of the driver, as a binary is only valid for
+ * the driver that created it.
+ */
+GLuint64 Shader::cacheKey(const std::string& vertexSource,
+                          const std::string& geometrySource,
+                          const std::string& fragmentSource)
+{
+  const GLchar* driverStrings[] = {
+    (const GLchar*)glGetString(GL_VENDOR),
+    (const GLchar*)glGetString(GL_RENDERER),
+    (const GLchar*)glGetString(GL_VERSION)
+  };
+  GLuint64 key = hashBytes(NULL, 0);
+
+  // The terminating null characters keep the sources apart in the hash.
+  key = hashBytes(vertexSource.c_str(), vertexSource.size() + 1, key);
+  key = hashBytes(geometrySource.c_str(), geometrySource.size() + 1, key);
+  key = hashBytes(fragmentSource.c_str(), fragmentSource.size() + 1, key);
+
+  for (GLuint i = 0; i < 3; i++) {
+    if (driverStrings[i]) {
+      key = hashBytes(driverStrings[i], strlen(driverStrings[i]) + 1, key);
+    }
+  }
+
+  return key;
+}
+
+/**
+ * Return the path of the program binary: the vertex shader file followed by
+ * the names of the other stages, so that programs sharing a vertex shader get
+ * their own binaries, e.g. "model.vert+model.geom+model.frag.bin".
+ */
+std::string Shader::binaryFilepath() const
+{
+  using namespace std;
+
+  const string* stageFiles[] = { &geometryShaderFile, &fragmentShaderFile };
+  string filepath = vertexShaderFile;
+
+  for (GLuint i = 0; i < 2; i++) {
+    if (!stageFiles[i]->empty()) {
+      filepath += "+" +
+        stageFiles[i]->substr(stageFiles[i]->find_last_of('/') + 1);
+    }
+  }
+
+  return filepath + PROGRAM_CACHE_EXTENSION;
+}
+
+/**
+ * Create the program from the binary cached next to the vertex shader file.
+ * Returns false if there is no binary for the given key, or if the driver
+ * rejects it, e.g. because its format is no longer supported.
+ */
+GLuint Shader::loadBinary(GLuint64 key)
+{
+  using namespace std;
+
+  TraceZone zone("glProgramBinary");
+  ProgramCacheHeader header;
+  vector<GLchar> binary;
+  GLint linkStatus;
+  ifstream file(binaryFilepath(), ios::binary);
+
+  if (!file.is_open()) {
+    return false;
+  }
+
+  file.read((GLchar*)&header, sizeof(ProgramCacheHeader));
+
+  if (!file || header.magic != PROGRAM_CACHE_MAGIC ||
+      header.version != PROGRAM_CACHE_VERSION || header.key != key) {
+    return false;
+  }
+
+  binary.resize(header.length);
+  file.read(binary.data(), header.length);
+
+  if (!file) {
+    return false;
+  }
+
+  id = glCreateProgram();
+  glProgramBinary(id, header.format, binary.data(), header.length);
+  glGetProgramiv(id, GL_LINK_STATUS, &linkStatus);
+
+  if (linkStatus != GL_TRUE) {
+    glDeleteProgram(id);
+    id = 0;
+
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Write the linked program's binary next to the vertex shader file. The file
+ * is written to a temporary path first and then renamed so that a partially
+ * written binary is never picked up by another run.
+ */
+GLvoid Shader::saveBinary(GLuint64 key)
+{
+  using namespace std;
+
+  ProgramCacheHeader header;
+  vector<GLchar> binary;
+  GLint length = 0;
+  string filepath = binaryFilepath();
+  string temporaryFilepath = filepath + ".tmp";
+
+  glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+
+  // Drivers without any binary formats return an empty binary.
+  if (length <= 0) {
+    return;
+  }
+
+  binary.resize(length);
+  header.magic = PROGRAM_CACHE_MAGIC;
+  header.version = PROGRAM_CACHE_VERSION;
+  header.key = key;
+  glGetProgramBinary(id, length, &length, &header.format, binary.data());
+  header.length = length;
+
+  ofstream file(temporaryFilepath, ios::binary | ios::trunc);
+
+  if (!file.is_open()) {
+    fprintf(stderr, "\nFailed to write program binary: %s\n",
+            temporaryFilepath.c_str());
+    return;
+  }
+
+  file.write((const GLchar*)&header, sizeof(ProgramCacheHeader));
+  file.write(binary.data(), header.length);
+  file.close();
+
+  if (!file || rename(temporaryFilepath.c_str(), filepath.c_str()) != 0) {
+    fprintf(stderr, "\nFailed to write program binary: %s\n",
+            filepath.c_str());
+    unlink(temporaryFilepath.c_str());
+  }
+}
+
+GLuint Shader::isComputeShader() const
+{
+  return hasExtension(vertexShaderFile, ".comp");
+}
+
+/**
+ * Start compiling a shader stage of the given type from the given source and
+ * return its ID. The status is checked later by finish.
+ */
+GLuint Shader::compile(GLenum type, const std::string& source,
+                       const std::string& file)
+{
+  TraceZone zone("glCompileShader");
+  const GLchar* sourceString = source.c_str();
+  GLuint shaderID = glCreateShader(type);
+
+  zone.addArgument("file", file);
+
+  glShaderSource(shaderID, 1, &sourceString, NULL);
+  glCompileShader(shaderID);
+
+  return shaderID;
+}
+
+/**
+ * Report the compile log of the given shader stage if it failed to compile.
+ * Returns whether it compiled. The file and stage name are only used to
+ * report errors.
+ */
+GLuint Shader::checkCompileStatus(GLuint shaderID, const std::string& file,
+                                  const GLchar* stageName)
+{
+  GLint compileStatus;
+  GLchar compileLog[LOG_MSG_LENGTH];
+
+  glGetShaderiv(shaderID, GL_COMPILE_STATUS, &compileStatus);
+
+  if (compileStatus != GL_TRUE) {
+    glGetShaderInfoLog(shaderID, LOG_MSG_LENGTH, NULL, compileLog);
+    fprintf(stderr, "\n%s compilation error (ID: %d) in file: %s\n%s\n",
+            stageName, shaderID, file.c_str(), compileLog);
+
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Look up the program's active uniforms once, so that their locations can be
+ * found later without asking the driver. Material samplers and the vertex and
+ * index buffer samplers are bound to fixed texture units, and the Frame
+ * uniform block to its shared binding point. Programs without an active
+ * material sampler have no textures bound for their draws. The per-draw
+ * uniforms are kept in members so the render queue skips the lookup.
+ */
+GLvoid Shader::reflectUniforms()
+{
+  GLint uniformCount, size, location, unit;
+  GLenum type;
+  GLchar name[UNIFORM_NAME_LENGTH];
+  GLsizei length;
+  GLuint blockIndex;
+
+  uniforms.clear();
+  isMaterialUsed = false;
+  glUseProgram(id);
+  glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &uniformCount);
+
+  for (GLint i = 0; i < uniformCount; i++) {
+    glGetActiveUniform(id, i, UNIFORM_NAME_LENGTH, &length, &size, &type, name);
+    location = glGetUniformLocation(id, name);
+
+    // Uniforms in a uniform block have no location.
+    if (location < 0) {
+      continue;
+    }
+
+    std::string uniformName(name, length);
+
+    if (uniformName.size() > 3 &&
+        uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+      uniformName.erase(uniformName.size() - 3);
+    }
+
+    uniforms[uniformName] = location;
+
+    // Material samplers are named material.<type><number>, e.g. diffuse1.
+    if ((type == GL_SAMPLER_2D || type == GL_SAMPLER_2D_ARRAY) &&
+        !uniformName.compare(0, 9, "material.")) {
+      size_t numberStart = uniformName.find_first_of("0123456789");
+
+      if (numberStart != std::string::npos) {
+        unit = textureUnit(uniformName.substr(9, numberStart - 9),
+                           atoi(uniformName.c_str() + numberStart));
+
+        if (unit >= 0) {
+          glUniform1i(location, unit);
+          isMaterialUsed = true;
+        }
+      }
+    } else if (uniformName == "vertexBuffer") {
+      glUniform1i(location, VERTEX_BUFFER_UNIT);
+    } else if (uniformName == "indexBuffer") {
+      glUniform1i(location, INDEX_BUFFER_UNIT);
+    }
+  }
+
+  blockIndex = glGetUniformBlockIndex(id, "Frame");
+
+  if (blockIndex != GL_INVALID_INDEX) {
+    glUniformBlockBinding(id, blockIndex, FRAME_UNIFORM_BINDING);
+  }
+
+  modelLocation = uniform("model");
+  normalMatrixLocation = uniform("normalMatrix");
+  baseVertexLocation = uniform("baseVertex");
+  glUseProgram(0);
+}
+
+/**
+ * Return the location of the given uniform, or -1 if it is not active.
+ */
+GLint Shader::uniform(const std::string& name) const
+{
+  std::unordered_map<std::string, GLint>::const_iterator location =
+    uniforms.find(name);
+
+  return (location != uniforms.end()) ? location->second : -1;
+}
+
+/**
+ * Return whether the program samples any material texture.
+ */
+GLuint Shader::usesMaterials() const
+{
+  return isMaterialUsed;
 }
 
 GLvoid Shader::unload()
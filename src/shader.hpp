@@ -5,23 +5,113 @@
 #ifndef SHADER_HEADER
 #define SHADER_HEADER
 
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #define LOG_MSG_LENGTH 256
+#define UNIFORM_NAME_LENGTH 256
+#define FRAME_UNIFORM_BINDING 0
+
+#define PROGRAM_CACHE_MAGIC     0x42504d4d // "MMPB"
+#define PROGRAM_CACHE_VERSION   1
+#define PROGRAM_CACHE_EXTENSION ".bin"
+
+/**
+ * A cached program binary starts with this header. The key is a hash of the
+ * shader sources and the driver that built the binary, so a binary is only
+ * reused by the same program on the same driver.
+ */
+struct ProgramCacheHeader {
+  GLuint magic;
+  GLuint version;
+  GLenum format;
+  GLuint length;
+  GLuint64 key;
+};
+
+/**
+ * The std140 layout of the Frame uniform block shared by every program.
+ */
+struct LightUniforms {
+  glm::vec4 position;
+  glm::vec4 ambient;
+  glm::vec4 diffuse;
+  glm::vec4 specular;
+  GLfloat constant;
+  GLfloat linear;
+  GLfloat quadratic;
+  GLfloat padding;
+};
+
+struct FrameUniforms {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec4 viewPosition;
+  LightUniforms light;
+};
 
 class Shader
 {
   public:
     GLuint id;
+    GLuint isCacheEnabled;
+
+    // The primitive drawn by a program that fetches its own vertices from the
+    // vertex and index buffers (one per index, or two for GL_LINES), or 0.
+    GLenum pulledPrimitive;
+
+    // Whether the program only reads vertex positions and normals, and so can
+    // draw from a model's position stream.
+    GLuint isPositionStreamUsed;
+
+    // Whether the program draws lines from each vertex, such as its normal,
+    // which stay visible on back faces and so must not be culled with them.
+    GLuint isLineDrawn;
+
+    // The locations of the per-draw uniforms set by the render queue, or -1.
+    GLint modelLocation;
+    GLint normalMatrixLocation;
+    GLint baseVertexLocation;
 
     Shader(std::string vertexFile = "", std::string fragmentFile = "",
            std::string geometryFile = "");
     GLvoid load();
+    GLvoid submit();
+    GLvoid finish();
+    GLuint reload();
+    GLuint usesFile(const std::string& file) const;
+    std::vector<std::string> files() const;
     GLvoid unload();
     GLvoid use();
+    GLint uniform(const std::string& name) const;
+    GLuint usesMaterials() const;
 
   private:
+    std::unordered_map<std::string, GLint> uniforms;
     std::string vertexShaderFile;
     std::string geometryShaderFile;
     std::string fragmentShaderFile;
+    GLuint vertexShaderID;
+    GLuint geometryShaderID;
+    GLuint fragmentShaderID;
+    GLuint64 binaryKey;
+    GLuint isMaterialUsed;
+
+    GLuint64 cacheKey(const std::string& vertexSource,
+                      const std::string& geometrySource,
+                      const std::string& fragmentSource);
+    std::string binaryFilepath() const;
+    GLuint loadBinary(GLuint64 key);
+    GLvoid saveBinary(GLuint64 key);
+    GLuint isComputeShader() const;
+    GLuint completeLink();
+    GLuint compile(GLenum type, const std::string& source,
+                   const std::string& file);
+    GLuint checkCompileStatus(GLuint shaderID, const std::string& file,
+                              const GLchar* stageName);
+    GLvoid reflectUniforms();
 };
   
 #endif
\ No newline at end of file
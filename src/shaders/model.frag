@@ -1,16 +1,16 @@
 #version 330 core
 
 struct Material {
-  sampler2D diffuse1;
-  sampler2D specular1;
+  sampler2DArray diffuse1;
+  sampler2DArray specular1;
   float shininess;
 };
 
 struct Light {
   vec4 position;
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
 
   float constant;
   float linear;
@@ -21,14 +21,21 @@ in Data {
   vec4 position;
   vec3 normal;
   vec2 textureCoords;
+  flat ivec2 layers;
+  vec4 tint;
   noperspective vec3 wireframeDistance;
 } fragment;
 
 out vec4 colour;
 
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPosition;
+  Light light;
+};
+
 uniform Material material;
-uniform Light light;
-uniform vec4 viewPosition;
 uniform vec4 wireframeColour;
 uniform bool isWireframeEnabled;
 uniform bool areFacesEnabled;
@@ -51,12 +58,16 @@ void main()
   float specularStrength = pow(max(dot(fragment.normal, halfwayDirection),
                                    0.0f), material.shininess);
 
-  vec3 ambient  = light.ambient  * vec3(texture(material.diffuse1,
-                                   fragment.textureCoords));
-  vec3 diffuse  = light.diffuse  * (vec3(texture(material.diffuse1,
-                                   fragment.textureCoords)) * diffuseStrength); 
-  vec3 specular = light.specular * (vec3(texture(material.specular1,
-                                   fragment.textureCoords)) * specularStrength);
+  vec3 diffuseColour  = vec3(texture(material.diffuse1,
+                                     vec3(fragment.textureCoords,
+                                          fragment.layers.x)));
+  vec3 specularColour = vec3(texture(material.specular1,
+                                     vec3(fragment.textureCoords,
+                                          fragment.layers.y)));
+
+  vec3 ambient  = light.ambient.rgb  * diffuseColour;
+  vec3 diffuse  = light.diffuse.rgb  * (diffuseColour * diffuseStrength);
+  vec3 specular = light.specular.rgb * (specularColour * specularStrength);
 
   float dist = length(light.position - fragment.position);
   float attenuation = 1.0f / (light.constant + light.linear * dist + 
@@ -66,7 +77,7 @@ void main()
   diffuse  *= attenuation;
   specular *= attenuation;
 
-  vec4 baseColour = vec4(ambient + diffuse + specular, 1.0f);
+  vec4 baseColour = vec4(ambient + diffuse + specular, 1.0f) * fragment.tint;
 
   if (!areFacesEnabled) {
     wireframeEnabled = true;
@@ -3,22 +3,51 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 textureCoords;
+layout (location = 3) in ivec2 layers;
+layout (location = 4) in mat4 instance;
+layout (location = 8) in vec4 tint;
 
 out Data {
   vec4 position;
   vec3 normal;
   vec2 textureCoords;
+  flat ivec2 layers;
+  vec4 tint;
+  noperspective vec3 wireframeDistance;
 } vertex;
 
+struct Light {
+  vec4 position;
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPosition;
+  Light light;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
-  gl_Position = projection * view * model * vec4(position, 1.0f);
+  mat4 transform = model * instance;
+
+  gl_Position = projection * view * transform * vec4(position, 1.0f);
 
-  vertex.position = model * vec4(position, 1.0f);
+  vertex.position = transform * vec4(position, 1.0f);
   vertex.normal = normal;
   vertex.textureCoords = textureCoords;
+  vertex.layers = layers;
+  vertex.tint = tint;
+
+  // Only the wireframe programs find the distance to the triangle's edges.
+  vertex.wireframeDistance = vec3(1.0f);
 }
\ No newline at end of file
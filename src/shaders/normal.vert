@@ -3,21 +3,44 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 textureCoords;
+layout (location = 4) in mat4 instance;
 
 out Data {
   vec3 normal;
   vec4 vNormal;
 } vertex;
 
+struct Light {
+  vec4 position;
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPosition;
+  Light light;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix;
 
 void main()
 {
-  gl_Position = projection * view * model * vec4(position, 1.0f);
+  mat4 transform = model * instance;
+
+  // The instance's normal matrix, if it only rotates and scales uniformly.
+  mat3 instanceNormal = mat3(instance) / dot(instance[0].xyz, instance[0].xyz);
+
+  gl_Position = projection * view * transform * vec4(position, 1.0f);
 
   vertex.normal = normal;
-  vertex.vNormal = normalize(projection * vec4(mat3(
-                   transpose(inverse(view * model))) * normal, 1.0f));
+  vertex.vNormal = normalize(projection * vec4(normalMatrix * instanceNormal *
+                                               normal, 1.0f));
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#version 330 core
+
+layout (location = 4) in mat4 instance;
+
+out Data {
+  vec4 colour;
+} vertex;
+
+struct Light {
+  vec4 position;
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPosition;
+  Light light;
+};
+
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform samplerBuffer vertexBuffer;
+uniform usamplerBuffer indexBuffer;
+uniform int baseVertex;
+uniform float normalLength;
+
+void main()
+{
+  // Each pair of vertices of the draw is a line along the normal of the
+  // vertex at one index of the mesh's triangles.
+  int index = baseVertex + int(texelFetch(indexBuffer, gl_VertexID / 2).r);
+  vec4 positionNormal = texelFetch(vertexBuffer, index * 2);
+  vec3 normal = vec3(positionNormal.w,
+                     texelFetch(vertexBuffer, index * 2 + 1).xy);
+  bool isLineEnd = (gl_VertexID % 2) == 1;
+
+  // The instance's normal matrix, if it only rotates and scales uniformly.
+  mat3 instanceNormal = mat3(instance) / dot(instance[0].xyz, instance[0].xyz);
+  vec4 lineNormal = normalize(projection * vec4(normalMatrix * instanceNormal *
+                                                normal, 1.0f));
+
+  gl_Position = projection * view * model * instance *
+                vec4(positionNormal.xyz, 1.0f);
+
+  if (isLineEnd) {
+    gl_Position += lineNormal * normalLength;
+  }
+
+  vertex.colour = vec4(normal * 2.0f, isLineEnd ? 0.0f : 1.0f);
+}
@@ -0,0 +1,58 @@
+#version 330 core
+
+layout (location = 3) in ivec2 layers;
+layout (location = 4) in mat4 instance;
+layout (location = 8) in vec4 tint;
+
+out Data {
+  vec4 position;
+  vec3 normal;
+  vec2 textureCoords;
+  flat ivec2 layers;
+  vec4 tint;
+  noperspective vec3 wireframeDistance;
+} vertex;
+
+struct Light {
+  vec4 position;
+  vec4 ambient;
+  vec4 diffuse;
+  vec4 specular;
+
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+layout (std140) uniform Frame {
+  mat4 view;
+  mat4 projection;
+  vec4 viewPosition;
+  Light light;
+};
+
+uniform mat4 model;
+uniform samplerBuffer vertexBuffer;
+uniform usamplerBuffer indexBuffer;
+uniform int baseVertex;
+
+void main()
+{
+  // Each vertex of the draw is one index of the mesh's triangles, so its
+  // corner of the triangle gives the distance to the opposite edge.
+  int index = baseVertex + int(texelFetch(indexBuffer, gl_VertexID).r);
+  vec4 positionNormal = texelFetch(vertexBuffer, index * 2);
+  vec4 normalTextureCoords = texelFetch(vertexBuffer, index * 2 + 1);
+  mat4 transform = model * instance;
+
+  gl_Position = projection * view * transform *
+                vec4(positionNormal.xyz, 1.0f);
+
+  vertex.position = transform * vec4(positionNormal.xyz, 1.0f);
+  vertex.normal = vec3(positionNormal.w, normalTextureCoords.xy);
+  vertex.textureCoords = normalTextureCoords.zw;
+  vertex.layers = layers;
+  vertex.tint = tint;
+  vertex.wireframeDistance = vec3(0.0f);
+  vertex.wireframeDistance[gl_VertexID % 3] = 1.0f;
+}
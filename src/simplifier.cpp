@@ -0,0 +1,389 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "simplifier.hpp"
+
+#define NO_INDEX 0xffffffff
+
+/**
+ * Add the plane through the given triangle to the quadric, weighted by the
+ * triangle's area.
+ */
+static GLvoid addTriangleQuadric(Quadric& quadric, glm::vec3 p0, glm::vec3 p1,
+                                 glm::vec3 p2)
+{
+  glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+  GLfloat area = glm::length(normal) * 0.5f;
+  GLfloat distance;
+
+  if (area == 0.0f) {
+    return;
+  }
+
+  normal = glm::normalize(normal);
+  distance = -glm::dot(normal, p0);
+
+  quadric.a00 += area * normal.x * normal.x;
+  quadric.a01 += area * normal.x * normal.y;
+  quadric.a02 += area * normal.x * normal.z;
+  quadric.a11 += area * normal.y * normal.y;
+  quadric.a12 += area * normal.y * normal.z;
+  quadric.a22 += area * normal.z * normal.z;
+  quadric.b0 += area * normal.x * distance;
+  quadric.b1 += area * normal.y * distance;
+  quadric.b2 += area * normal.z * distance;
+  quadric.c += area * distance * distance;
+  quadric.weight += area;
+}
+
+static GLvoid addQuadric(Quadric& quadric, const Quadric& other)
+{
+  const GLfloat* source = &other.a00;
+  GLfloat* destination = &quadric.a00;
+
+  for (GLuint i = 0; i < sizeof(Quadric) / sizeof(GLfloat); i++) {
+    destination[i] += source[i];
+  }
+}
+
+/**
+ * Return the mean squared distance from the given point to the quadric's
+ * planes.
+ */
+static GLfloat quadricError(const Quadric& quadric, glm::vec3 p)
+{
+  GLfloat error;
+
+  if (quadric.weight == 0.0f) {
+    return 0.0f;
+  }
+
+  error = quadric.a00 * p.x * p.x + quadric.a11 * p.y * p.y +
+          quadric.a22 * p.z * p.z + 2.0f * (quadric.a01 * p.x * p.y +
+          quadric.a02 * p.x * p.z + quadric.a12 * p.y * p.z) +
+          2.0f * (quadric.b0 * p.x + quadric.b1 * p.y + quadric.b2 * p.z) +
+          quadric.c;
+
+  return std::max(error / quadric.weight, 0.0f);
+}
+
+/**
+ * Constructor to create a simplifier. Every level of detail it builds stays
+ * within the given error, relative to the mesh's bounding radius.
+ */
+MeshSimplifier::MeshSimplifier(GLfloat maxRelativeError)
+{
+  maxError = maxRelativeError;
+}
+
+/**
+ * Build the mesh's chain of simplified levels, each with about half of the
+ * triangles of the level before it. The chain stops at the first level that
+ * cannot get close enough to its target within the error bound. Each level's
+ * error is the sum of the errors of the simplifications that led to it, so
+ * it bounds the distance to the full mesh.
+ */
+GLvoid MeshSimplifier::buildLods(Mesh& mesh)
+{
+  std::vector<GLuint> indices = mesh.indices, lodIndices;
+  GLfloat error = 0.0f, stepError;
+  MeshLod lod;
+
+  mesh.lods.clear();
+  mesh.lodIndices.clear();
+
+  for (GLuint i = 0; i < MAX_MESH_LODS; i++) {
+    GLuint targetIndexCount = (GLuint)(indices.size() / 3 *
+                                       LOD_TRIANGLE_RATIO) * 3;
+
+    lodIndices = simplify(mesh, indices, targetIndexCount, maxError - error,
+                          &stepError);
+
+    if (lodIndices.empty() ||
+        lodIndices.size() > indices.size() * LOD_MIN_REDUCTION) {
+      break;
+    }
+
+    error += stepError;
+    lod.firstIndex = mesh.indices.size() + mesh.lodIndices.size();
+    lod.indexCount = lodIndices.size();
+    lod.error = error;
+    mesh.lods.push_back(lod);
+    mesh.lodIndices.insert(mesh.lodIndices.end(), lodIndices.begin(),
+                           lodIndices.end());
+    indices.swap(lodIndices);
+  }
+}
+
+/**
+ * Simplify the given triangles of the mesh towards the target index count by
+ * collapsing edges in order of their quadric error, without moving any vertex
+ * further than the error limit (relative to the mesh's bounding radius) from
+ * the surface. Only indices change: each collapse moves one vertex onto an
+ * existing neighbour, so every level shares the mesh's vertices.
+ *
+ * UV seams and open borders are locked so the surface does not tear, and
+ * collapses that would flip a triangle are skipped. Each pass collapses the
+ * cheapest edges whose vertices are untouched so far in the pass, then the
+ * adjacency is rebuilt. The error of the simplified triangles is returned.
+ */
+std::vector<GLuint> MeshSimplifier::simplify(
+  const Mesh& mesh, const std::vector<GLuint>& sourceIndices,
+  GLuint targetIndexCount, GLfloat errorLimit, GLfloat* error)
+{
+  GLuint vertexCount = mesh.vertices.size();
+  std::vector<GLuint> indices(sourceIndices);
+  std::vector<GLuint> remap(vertexCount), isTouched(vertexCount);
+  std::vector<Collapse> collapses;
+  GLfloat errorLimitSquared = errorLimit * errorLimit, maxErrorSquared = 0.0f;
+
+  *error = 0.0f;
+
+  if (vertexCount == 0 || errorLimit <= 0.0f) {
+    return indices;
+  }
+
+  normalizePositions(mesh);
+  lockSeamsAndBorders(indices);
+
+  // Sum the planes of the triangles around each vertex.
+  quadrics.assign(vertexCount, Quadric());
+
+  for (GLuint i = 0; i + 2 < indices.size(); i += 3) {
+    Quadric quadric = Quadric();
+
+    addTriangleQuadric(quadric, positions[indices[i]],
+                       positions[indices[i + 1]], positions[indices[i + 2]]);
+
+    for (GLuint j = 0; j < 3; j++) {
+      addQuadric(quadrics[indices[i + j]], quadric);
+    }
+  }
+
+  while (indices.size() > targetIndexCount) {
+    // Each collapse removes about two triangles.
+    GLuint collapseLimit = (indices.size() - targetIndexCount) / 6 + 1;
+    GLuint collapseCount = 0, indexCount = 0;
+
+    buildAdjacency(indices);
+    collapses.clear();
+
+    for (GLuint i = 0; i < indices.size(); i++) {
+      GLuint a = indices[i];
+      GLuint b = indices[i - i % 3 + (i + 1) % 3];
+      Quadric quadric = quadrics[a];
+
+      addQuadric(quadric, quadrics[b]);
+
+      if (!isLocked[a]) {
+        Collapse collapse = { a, b, quadricError(quadric, positions[b]) };
+        collapses.push_back(collapse);
+      }
+
+      if (!isLocked[b]) {
+        Collapse collapse = { b, a, quadricError(quadric, positions[a]) };
+        collapses.push_back(collapse);
+      }
+    }
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& a, const Collapse& b) {
+                return a.error < b.error;
+              });
+
+    for (GLuint i = 0; i < vertexCount; i++) {
+      remap[i] = i;
+      isTouched[i] = false;
+    }
+
+    for (GLuint i = 0; i < collapses.size(); i++) {
+      const Collapse& collapse = collapses[i];
+
+      if (collapse.error > errorLimitSquared ||
+          collapseCount >= collapseLimit) {
+        break;
+      }
+
+      if (isTouched[collapse.from] || isTouched[collapse.to] ||
+          isFlipped(indices, collapse.from, collapse.to)) {
+        continue;
+      }
+
+      remap[collapse.from] = collapse.to;
+      addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+      isTouched[collapse.from] = isTouched[collapse.to] = true;
+      maxErrorSquared = std::max(maxErrorSquared, collapse.error);
+      collapseCount++;
+    }
+
+    if (!collapseCount) {
+      break;
+    }
+
+    // Move the collapsed vertices and remove the triangles that vanish.
+    for (GLuint i = 0; i + 2 < indices.size(); i += 3) {
+      GLuint a = remap[indices[i]];
+      GLuint b = remap[indices[i + 1]];
+      GLuint c = remap[indices[i + 2]];
+
+      if (a != b && b != c && c != a) {
+        indices[indexCount++] = a;
+        indices[indexCount++] = b;
+        indices[indexCount++] = c;
+      }
+    }
+
+    indices.resize(indexCount);
+  }
+
+  *error = sqrtf(maxErrorSquared);
+
+  return indices;
+}
+
+/**
+ * Copy the mesh's positions into the simplifier, moved and scaled so that the
+ * mesh's bounding sphere is the unit sphere, which makes every error relative
+ * to the bounding radius.
+ */
+GLvoid MeshSimplifier::normalizePositions(const Mesh& mesh)
+{
+  glm::vec3 min = mesh.vertices[0].position, max = min, center;
+  GLfloat radius;
+
+  for (GLuint i = 1; i < mesh.vertices.size(); i++) {
+    min = glm::min(min, mesh.vertices[i].position);
+    max = glm::max(max, mesh.vertices[i].position);
+  }
+
+  center = (min + max) * 0.5f;
+  radius = glm::length(max - center);
+  radius = (radius > 0.0f) ? radius : 1.0f;
+  positions.resize(mesh.vertices.size());
+
+  for (GLuint i = 0; i < mesh.vertices.size(); i++) {
+    positions[i] = (mesh.vertices[i].position - center) / radius;
+  }
+}
+
+/**
+ * Lock every vertex that shares its position with another vertex (a seam in
+ * the normals or texture coordinates) or lies on an edge with other than two
+ * triangles (an open border or a non-manifold edge).
+ */
+GLvoid MeshSimplifier::lockSeamsAndBorders(const std::vector<GLuint>& indices)
+{
+  std::vector<GLuint> positionIDs(positions.size());
+  std::vector<GLuint> positionCounts, table;
+  std::vector<GLuint> isPositionLocked;
+  std::unordered_map<GLuint64, GLuint> edgeCounts;
+  size_t tableSize = 1;
+
+  while (tableSize < positions.size() * 2) {
+    tableSize *= 2;
+  }
+
+  // Find each position in an open addressing hash table of unique positions.
+  table.assign(tableSize, NO_INDEX);
+
+  for (GLuint i = 0; i < positions.size(); i++) {
+    size_t slot = hashBytes(&positions[i], sizeof(glm::vec3)) &
+                  (tableSize - 1);
+
+    while (table[slot] != NO_INDEX && positions[table[slot]] != positions[i]) {
+      slot = (slot + 1) & (tableSize - 1);
+    }
+
+    if (table[slot] == NO_INDEX) {
+      table[slot] = i;
+      positionIDs[i] = positionCounts.size();
+      positionCounts.push_back(0);
+    } else {
+      positionIDs[i] = positionIDs[table[slot]];
+    }
+
+    positionCounts[positionIDs[i]]++;
+  }
+
+  isPositionLocked.assign(positionCounts.size(), false);
+
+  for (GLuint i = 0; i < indices.size(); i++) {
+    GLuint a = positionIDs[indices[i]];
+    GLuint b = positionIDs[indices[i - i % 3 + (i + 1) % 3]];
+
+    edgeCounts[((GLuint64)std::min(a, b) << 32) | std::max(a, b)]++;
+  }
+
+  for (auto edge = edgeCounts.begin(); edge != edgeCounts.end(); edge++) {
+    if (edge->second != 2) {
+      isPositionLocked[edge->first >> 32] = true;
+      isPositionLocked[edge->first & 0xffffffff] = true;
+    }
+  }
+
+  isLocked.resize(positions.size());
+
+  for (GLuint i = 0; i < positions.size(); i++) {
+    isLocked[i] = positionCounts[positionIDs[i]] > 1 ||
+                  isPositionLocked[positionIDs[i]];
+  }
+}
+
+/**
+ * Build the list of triangles around each vertex.
+ */
+GLvoid MeshSimplifier::buildAdjacency(const std::vector<GLuint>& indices)
+{
+  std::vector<GLuint> counts(positions.size(), 0);
+
+  adjacencyOffsets.assign(positions.size() + 1, 0);
+  adjacency.resize(indices.size());
+
+  for (GLuint i = 0; i < indices.size(); i++) {
+    adjacencyOffsets[indices[i] + 1]++;
+  }
+
+  for (GLuint i = 0; i < positions.size(); i++) {
+    adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+  }
+
+  for (GLuint i = 0; i < indices.size(); i++) {
+    GLuint vertex = indices[i];
+    adjacency[adjacencyOffsets[vertex] + counts[vertex]++] = i / 3;
+  }
+}
+
+/**
+ * Return whether moving the from vertex onto the to vertex would turn any of
+ * the triangles around it that are kept by the collapse upside down.
+ */
+GLuint MeshSimplifier::isFlipped(const std::vector<GLuint>& indices,
+                                 GLuint from, GLuint to)
+{
+  for (GLuint i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1];
+       i++) {
+    const GLuint* triangle = &indices[adjacency[i] * 3];
+    glm::vec3 corners[3], moved[3];
+
+    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+      continue;
+    }
+
+    for (GLuint j = 0; j < 3; j++) {
+      corners[j] = positions[triangle[j]];
+      moved[j] = (triangle[j] == from) ? positions[to] : corners[j];
+    }
+
+    if (glm::dot(glm::cross(corners[1] - corners[0], corners[2] - corners[0]),
+                 glm::cross(moved[1] - moved[0], moved[2] - moved[0])) <=
+        0.0f) {
+      return true;
+    }
+  }
+
+  return false;
+}
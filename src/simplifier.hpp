@@ -0,0 +1,62 @@
+/**
+ * [Program description]
+ */
+
+#ifndef SIMPLIFIER_HEADER
+#define SIMPLIFIER_HEADER
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "mesh.hpp"
+
+#define LOD_TRIANGLE_RATIO 0.5f  // triangles kept by each level of the last
+#define LOD_MIN_REDUCTION  0.75f // most triangles a level may keep to be used
+#define LOD_MAX_ERROR      0.05f // relative to the mesh's bounding radius
+
+/**
+ * A quadric error matrix, holding the sum of the squared distances to a set
+ * of planes weighted by the areas of their triangles.
+ */
+struct Quadric {
+  GLfloat a00, a01, a02, a11, a12, a22;
+  GLfloat b0, b1, b2;
+  GLfloat c;
+  GLfloat weight;
+};
+
+/**
+ * A collapse of an edge that moves one vertex onto the other.
+ */
+struct Collapse {
+  GLuint from;
+  GLuint to;
+  GLfloat error;
+};
+
+class MeshSimplifier
+{
+  public:
+    GLfloat maxError;
+
+    MeshSimplifier(GLfloat maxRelativeError = LOD_MAX_ERROR);
+    GLvoid buildLods(Mesh& mesh);
+    std::vector<GLuint> simplify(const Mesh& mesh,
+                                 const std::vector<GLuint>& sourceIndices,
+                                 GLuint targetIndexCount, GLfloat errorLimit,
+                                 GLfloat* error);
+
+  private:
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> isLocked;
+    std::vector<Quadric> quadrics;
+    std::vector<GLuint> adjacencyOffsets;
+    std::vector<GLuint> adjacency;
+
+    GLvoid normalizePositions(const Mesh& mesh);
+    GLvoid lockSeamsAndBorders(const std::vector<GLuint>& indices);
+    GLvoid buildAdjacency(const std::vector<GLuint>& indices);
+    GLuint isFlipped(const std::vector<GLuint>& indices, GLuint from,
+                     GLuint to);
+};
+
+#endif
@@ -0,0 +1,426 @@
+/**
+ * [Program description]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fcntl.h>
+#include <mutex>
+#include <queue>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "texture.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "third_party/stb_image.h"
+
+/**
+ * Constructor to create a texture loader. If no thread count is given, one
+ * decoding thread is used per hardware thread.
+ */
+TextureLoader::TextureLoader(GLuint desiredThreadCount)
+{
+  threadCount = desiredThreadCount;
+  isBakingEnabled = true;
+  isCompressionEnabled = false;
+  isPackingEnabled = false;
+
+  if (threadCount == 0) {
+    threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+}
+
+/**
+ * Load the textures from the given files as 2D array textures and return
+ * their IDs and layers in the same order. The images are read on a pool of
+ * worker threads while this (context) thread uploads each image as soon as it
+ * has been read, as its own single layer array.
+ *
+ * If packing is enabled, the upload waits until every image is read, and
+ * images with the same size, format and mip levels share one array, each in
+ * its own layer, so they can be drawn without binding another texture.
+ */
+std::vector<GLuint> TextureLoader::load(
+  const std::vector<std::string>& filepaths, std::vector<GLuint>& layers)
+{
+  using namespace std;
+
+  TraceZone zone("TextureLoader::load");
+  vector<GLuint> textureIDs(filepaths.size());
+  vector<Image> images(filepaths.size());
+  vector<thread> workers;
+  queue<GLuint> decoded;
+  mutex decodedMutex;
+  condition_variable isDecoded;
+  atomic<GLuint> nextImage(0);
+  GLuint workerCount = min<size_t>(threadCount, filepaths.size());
+  GLdouble startTime = currentTime();
+  GLdouble serialDecodeTime = 0.0;
+  GLuint arrayCount = 0;
+
+  zone.addArgument("count", filepaths.size());
+  layers.assign(filepaths.size(), 0);
+
+  for (GLuint i = 0; i < workerCount; i++) {
+    workers.push_back(thread([&]() {
+      GLuint index;
+
+      while ((index = nextImage++) < filepaths.size()) {
+        images[index] = read(filepaths[index]);
+
+        lock_guard<mutex> lock(decodedMutex);
+        decoded.push(index);
+        isDecoded.notify_one();
+      }
+    }));
+  }
+
+  // Upload the images in the order they finish decoding.
+  for (GLuint i = 0; i < filepaths.size(); i++) {
+    GLuint index;
+
+    {
+      unique_lock<mutex> lock(decodedMutex);
+      isDecoded.wait(lock, [&]() { return !decoded.empty(); });
+      index = decoded.front();
+      decoded.pop();
+    }
+
+    serialDecodeTime += images[index].decodeTime;
+
+    if (!isPackingEnabled) {
+      textureIDs[index] = upload(vector<Image*>(1, &images[index]));
+      release(images[index]);
+      arrayCount++;
+    }
+  }
+
+  for (GLuint i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+
+  // Pack each image into the array of the first image it matches. Packed
+  // images are released, so they never match again.
+  for (GLuint i = 0; isPackingEnabled && i < images.size(); i++) {
+    vector<Image*> layerImages;
+
+    if (textureIDs[i]) {
+      continue;
+    }
+
+    for (GLuint j = i; j < images.size(); j++) {
+      if (j == i || isPackable(images[i], images[j])) {
+        layers[j] = layerImages.size();
+        layerImages.push_back(&images[j]);
+      }
+    }
+
+    GLuint textureID = upload(layerImages);
+
+    for (GLuint j = 0; j < layerImages.size(); j++) {
+      textureIDs[layerImages[j] - images.data()] = textureID;
+      release(*layerImages[j]);
+    }
+
+    arrayCount++;
+  }
+
+  if (!filepaths.empty()) {
+    printf("Loaded %lu textures into %u arrays in %.1f ms on %u threads "
+           "(serial decode: %.1f ms)\n",
+           (unsigned long)filepaths.size(), arrayCount,
+           (currentTime() - startTime) * 1000.0, workerCount,
+           serialDecodeTime * 1000.0);
+  }
+
+  return textureIDs;
+}
+
+/**
+ * Read the baked texture of the given image file. If baking is enabled and
+ * the baked file is up to date, it is mapped. Otherwise the image is decoded
+ * into RGBA pixels and baked, and the baked file written if baking is enabled.
+ * This does not use OpenGL, so it is safe to call from any thread.
+ */
+Image TextureLoader::read(const std::string& filepath)
+{
+  TraceZone zone("TextureLoader::read");
+  Image image;
+  GLint width, height;
+  GLubyte* pixels;
+  GLdouble startTime = currentTime();
+
+  image.header = NULL;
+  image.mappedData = NULL;
+  image.mappedSize = 0;
+  zone.addArgument("file", filepath);
+
+  if (isBakingEnabled && openBaked(filepath, image)) {
+    image.decodeTime = currentTime() - startTime;
+    zone.addArgument("bytes", (GLuint64)image.mappedSize);
+
+    return image;
+  }
+
+  {
+    TraceZone decodeZone("stbi_load");
+    pixels = stbi_load(filepath.c_str(), &width, &height, 0, STBI_rgb_alpha);
+  }
+
+  if (!pixels) {
+    fprintf(stderr, "\nLoad texture error in file: %s\n%s\n",
+            filepath.c_str(), stbi_failure_reason());
+    image.decodeTime = currentTime() - startTime;
+
+    return image;
+  }
+
+  bakeTexture(pixels, width, height, options(), image.bakedData);
+  stbi_image_free(pixels);
+  image.header = (const TextureHeader*)image.bakedData.data();
+  image.decodeTime = currentTime() - startTime;
+  zone.addArgument("bytes", (GLuint64)image.bakedData.size());
+
+  if (isBakingEnabled) {
+    writeBaked(filepath, image);
+  }
+
+  return image;
+}
+
+/**
+ * Map the baked file of the given image file into the image. Returns false
+ * if there is no baked file, or if it does not match the image file and the
+ * current bake options.
+ */
+GLuint TextureLoader::openBaked(const std::string& filepath, Image& image)
+{
+  std::string bakedFilepath = filepath + BAKED_TEXTURE_EXTENSION;
+  struct stat attributes;
+  const TextureHeader* header;
+  GLuint64 sourceSize;
+  GLint64 sourceTime;
+  GLuint isValid;
+  GLint fd = ::open(bakedFilepath.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  if (fstat(fd, &attributes) != 0 ||
+      (size_t)attributes.st_size < sizeof(TextureHeader)) {
+    ::close(fd);
+    return false;
+  }
+
+  image.mappedSize = attributes.st_size;
+  image.mappedData = (GLubyte*)mmap(NULL, image.mappedSize, PROT_READ,
+                                    MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (image.mappedData == MAP_FAILED) {
+    image.mappedData = NULL;
+    image.mappedSize = 0;
+    return false;
+  }
+
+  header = (const TextureHeader*)image.mappedData;
+  isValid = header->magic == BAKED_TEXTURE_MAGIC &&
+            header->version == BAKED_TEXTURE_VERSION &&
+            header->options == options() &&
+            header->levelCount > 0 &&
+            header->levelCount <= BAKED_TEXTURE_LEVELS &&
+            readSourceAttributes(filepath, &sourceSize, &sourceTime) &&
+            sourceSize == header->sourceSize &&
+            sourceTime == header->sourceTime;
+
+  // Make sure a truncated or corrupt file is never read past its end.
+  for (GLuint i = 0; isValid && i < header->levelCount; i++) {
+    isValid = header->levels[i].offset + header->levels[i].size <=
+              image.mappedSize;
+  }
+
+  if (!isValid) {
+    release(image);
+    return false;
+  }
+
+  image.header = header;
+
+  return true;
+}
+
+/**
+ * Write the image's baked data next to its image file. The file is written to
+ * a temporary path first and then renamed so that a partially written file is
+ * never picked up by another run.
+ */
+GLvoid TextureLoader::writeBaked(const std::string& filepath,
+                                 const Image& image)
+{
+  using namespace std;
+
+  TextureHeader header = *image.header;
+  string bakedFilepath = filepath + BAKED_TEXTURE_EXTENSION;
+  string temporaryFilepath = bakedFilepath + ".tmp";
+
+  if (!readSourceAttributes(filepath, &header.sourceSize,
+                            &header.sourceTime)) {
+    return;
+  }
+
+  ofstream file(temporaryFilepath, ios::binary | ios::trunc);
+
+  if (!file.is_open()) {
+    fprintf(stderr, "\nFailed to write baked texture: %s\n",
+            temporaryFilepath.c_str());
+    return;
+  }
+
+  file.write((const GLchar*)&header, sizeof(TextureHeader));
+  file.write((const GLchar*)image.bakedData.data() + sizeof(TextureHeader),
+             image.bakedData.size() - sizeof(TextureHeader));
+  file.close();
+
+  if (!file ||
+      rename(temporaryFilepath.c_str(), bakedFilepath.c_str()) != 0) {
+    fprintf(stderr, "\nFailed to write baked texture: %s\n",
+            bakedFilepath.c_str());
+    unlink(temporaryFilepath.c_str());
+  }
+}
+
+GLuint TextureLoader::readSourceAttributes(const std::string& filepath,
+                                           GLuint64* sourceSize,
+                                           GLint64* sourceTime)
+{
+  struct stat attributes;
+
+  if (stat(filepath.c_str(), &attributes) != 0) {
+    return false;
+  }
+
+  *sourceSize = attributes.st_size;
+  *sourceTime = attributes.st_mtime;
+
+  return true;
+}
+
+GLuint TextureLoader::options()
+{
+  return isCompressionEnabled ? BAKE_COMPRESSED : 0;
+}
+
+/**
+ * Return whether two baked images can be layers of the same array texture.
+ */
+GLuint TextureLoader::isPackable(const Image& image, const Image& other)
+{
+  if (!image.header || !other.header) {
+    return false;
+  }
+
+  return image.header->format == other.header->format &&
+         image.header->width == other.header->width &&
+         image.header->height == other.header->height &&
+         image.header->levelCount == other.header->levelCount;
+}
+
+/**
+ * Create an array texture with one layer per baked image, uploading their
+ * precomputed mip levels as they are. The images must all be packable with
+ * the first. Textures stored as red only are swizzled to read as grey.
+ */
+GLuint TextureLoader::upload(const std::vector<Image*>& layerImages)
+{
+  TraceZone zone("glTexImage3D");
+  const TextureHeader* header = layerImages[0]->header;
+  GLuint textureID;
+  GLuint64 size = 0;
+  GLsizei layerCount = layerImages.size();
+  GLint greySwizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+  GLenum internalFormats[] = {
+    GL_R8, GL_RGB8, GL_RGBA8, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+    GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RED_RGTC1
+  };
+  GLenum pixelFormats[] = { GL_RED, GL_RGB, GL_RGBA };
+
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+  zone.addArgument("layers", (GLuint64)layerCount);
+
+  if (header) {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (GLuint i = 0; i < header->levelCount; i++) {
+      const TextureLevel& level = header->levels[i];
+      GLenum internalFormat = internalFormats[header->format];
+
+      // Allocate the level for every layer, then fill in each layer.
+      if (header->format <= TEXTURE_RGBA8) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, i, internalFormat, level.width,
+                     level.height, layerCount, 0,
+                     pixelFormats[header->format], GL_UNSIGNED_BYTE, NULL);
+      } else {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, internalFormat,
+                               level.width, level.height, layerCount, 0,
+                               level.size * layerCount, NULL);
+      }
+
+      for (GLsizei j = 0; j < layerCount; j++) {
+        const GLubyte* data = (const GLubyte*)layerImages[j]->header +
+                              level.offset;
+
+        if (header->format <= TEXTURE_RGBA8) {
+          glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, j, level.width,
+                          level.height, 1, pixelFormats[header->format],
+                          GL_UNSIGNED_BYTE, data);
+        } else {
+          glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, j,
+                                    level.width, level.height, 1,
+                                    internalFormat, level.size, data);
+        }
+      }
+
+      size += (GLuint64)level.size * layerCount;
+    }
+
+    zone.addArgument("bytes", size);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,
+                    header->levelCount - 1);
+
+    if (header->format == TEXTURE_R8 || header->format == TEXTURE_BC4) {
+      glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA,
+                       greySwizzle);
+    }
+  }
+
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  return textureID;
+}
+
+/**
+ * Free the image's baked data, unmapping its baked file if it was mapped.
+ */
+GLvoid TextureLoader::release(Image& image)
+{
+  if (image.mappedData) {
+    munmap(image.mappedData, image.mappedSize);
+  }
+
+  std::vector<GLubyte>().swap(image.bakedData);
+  image.header = NULL;
+  image.mappedData = NULL;
+  image.mappedSize = 0;
+}
@@ -0,0 +1,48 @@
+/**
+ * [Program description]
+ */
+
+#ifndef TEXTURE_HEADER
+#define TEXTURE_HEADER
+
+#include <string>
+#include <vector>
+#include "baker.hpp"
+
+/**
+ * A baked texture, either mapped from its baked file or baked in memory from
+ * its source image. The header is NULL if the image could not be read.
+ */
+struct Image {
+  const TextureHeader* header;
+  GLubyte* mappedData;
+  size_t mappedSize;
+  std::vector<GLubyte> bakedData;
+  GLdouble decodeTime;
+};
+
+class TextureLoader
+{
+  public:
+    GLuint threadCount;
+    GLuint isBakingEnabled;
+    GLuint isCompressionEnabled;
+    GLuint isPackingEnabled;
+
+    TextureLoader(GLuint desiredThreadCount = 0);
+    std::vector<GLuint> load(const std::vector<std::string>& filepaths,
+                             std::vector<GLuint>& layers);
+
+  private:
+    Image read(const std::string& filepath);
+    GLuint openBaked(const std::string& filepath, Image& image);
+    GLvoid writeBaked(const std::string& filepath, const Image& image);
+    GLuint readSourceAttributes(const std::string& filepath,
+                                GLuint64* sourceSize, GLint64* sourceTime);
+    GLuint options();
+    GLuint isPackable(const Image& image, const Image& other);
+    GLuint upload(const std::vector<Image*>& layerImages);
+    GLvoid release(Image& image);
+};
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * [Program description]
+ */
+
+#include "trace.hpp"
+
+Tracer tracer;
+
+Tracer::Tracer()
+{
+  enabled = false;
+  startTime = 0.0;
+}
+
+/**
+ * Start recording zones. Times in the trace are relative to this call.
+ */
+GLvoid Tracer::enable()
+{
+  startTime = currentTime();
+  enabled = true;
+}
+
+GLuint Tracer::isEnabled() const
+{
+  return enabled;
+}
+
+GLvoid Tracer::record(TraceEvent& event)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  events.push_back(std::move(event));
+}
+
+/**
+ * Write every recorded zone to the given file as complete ("X") events, with
+ * a name for each thread. Returns false if the file could not be written.
+ */
+GLuint Tracer::write(std::string filepath)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::ofstream file(filepath, std::ios::trunc);
+  GLuint threadCount = 0;
+
+  if (!file.is_open()) {
+    fprintf(stderr, "\nFailed to write trace: %s\n", filepath.c_str());
+    return false;
+  }
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+  for (GLuint i = 0; i < events.size(); i++) {
+    const TraceEvent& event = events[i];
+
+    threadCount = std::max(threadCount, event.threadID + 1);
+
+    file << "{\"name\":\"" << escapeJson(event.name)
+         << "\",\"ph\":\"X\",\"pid\":1"
+         << ",\"tid\":" << event.threadID
+         << ",\"ts\":" << (GLuint64)((event.startTime - startTime) * 1e6)
+         << ",\"dur\":" << (GLuint64)((event.endTime - event.startTime) * 1e6)
+         << ",\"args\":{" << event.arguments << "}},\n";
+  }
+
+  for (GLuint i = 0; i < threadCount; i++) {
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+         << ",\"args\":{\"name\":\""
+         << (i == 0 ? std::string("main") : "worker " + std::to_string(i))
+         << "\"}}" << (i + 1 < threadCount ? ",\n" : "\n");
+  }
+
+  file << "]}\n";
+  file.close();
+
+  printf("Wrote %u trace zones to %s\n", (GLuint)events.size(),
+         filepath.c_str());
+
+  return !file.fail();
+}
+
+TraceZone::TraceZone(const GLchar* name)
+{
+  isActive = tracer.isEnabled();
+
+  if (isActive) {
+    event.name = name;
+    event.threadID = traceThreadID();
+    event.startTime = currentTime();
+  }
+}
+
+TraceZone::~TraceZone()
+{
+  if (isActive) {
+    event.endTime = currentTime();
+    tracer.record(event);
+  }
+}
+
+GLvoid TraceZone::addArgument(const GLchar* key, const std::string& value)
+{
+  if (isActive) {
+    event.arguments += std::string(event.arguments.empty() ? "" : ",") +
+                       "\"" + key + "\":\"" + escapeJson(value) + "\"";
+  }
+}
+
+GLvoid TraceZone::addArgument(const GLchar* key, GLuint64 value)
+{
+  if (isActive) {
+    event.arguments += std::string(event.arguments.empty() ? "" : ",") +
+                       "\"" + key + "\":" + std::to_string(value);
+  }
+}
+
+/**
+ * Return a small ID for the calling thread, numbered in the order threads
+ * first record a zone. The first is assumed to be the main thread.
+ */
+GLuint traceThreadID()
+{
+  static std::atomic<GLuint> nextThreadID(0);
+  static thread_local GLuint threadID = nextThreadID++;
+
+  return threadID;
+}
+
+std::string escapeJson(const std::string& text)
+{
+  std::string escaped;
+
+  for (GLuint i = 0; i < text.size(); i++) {
+    if (text[i] == '"' || text[i] == '\\') {
+      escaped += '\\';
+      escaped += text[i];
+    } else if ((GLubyte)text[i] < 0x20) {
+      escaped += ' ';
+    } else {
+      escaped += text[i];
+    }
+  }
+
+  return escaped;
+}
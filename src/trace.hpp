@@ -0,0 +1,64 @@
+/**
+ * [Program description]
+ */
+
+#ifndef TRACE_HEADER
+#define TRACE_HEADER
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define TRACE_FILEPATH "trace.json"
+
+struct TraceEvent {
+  const GLchar* name;
+  std::string arguments;
+  GLdouble startTime;
+  GLdouble endTime;
+  GLuint threadID;
+};
+
+/**
+ * Collects timed zones from any thread and writes them as a Chrome trace
+ * (chrome://tracing or ui.perfetto.dev). Zones are only recorded while the
+ * tracer is enabled.
+ */
+class Tracer
+{
+  public:
+    Tracer();
+    GLvoid enable();
+    GLuint isEnabled() const;
+    GLvoid record(TraceEvent& event);
+    GLuint write(std::string filepath);
+
+  private:
+    GLuint enabled;
+    GLdouble startTime;
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+};
+
+/**
+ * Times the scope it is declared in. Arguments, such as the file or vertex
+ * count, can be added while it is open. When tracing is disabled a zone does
+ * nothing beyond checking the flag once.
+ */
+class TraceZone
+{
+  public:
+    TraceZone(const GLchar* name);
+    ~TraceZone();
+    GLvoid addArgument(const GLchar* key, const std::string& value);
+    GLvoid addArgument(const GLchar* key, GLuint64 value);
+
+  private:
+    TraceEvent event;
+    GLuint isActive;
+};
+
+GLuint traceThreadID();
+std::string escapeJson(const std::string& text);
+
+#endif
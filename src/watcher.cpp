@@ -0,0 +1,110 @@
+/**
+ * [Program description]
+ */
+
+#include "watcher.hpp"
+
+FileWatcher::FileWatcher()
+{
+  descriptor = -1;
+}
+
+/**
+ * Start the watcher. Returns false if file changes cannot be watched.
+ */
+GLuint FileWatcher::initialise()
+{
+#ifdef WATCHER_INOTIFY
+  descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+  return descriptor >= 0;
+}
+
+GLvoid FileWatcher::destroy()
+{
+  if (descriptor >= 0) {
+    close(descriptor);
+  }
+
+  descriptor = -1;
+  directories.clear();
+  filepaths.clear();
+}
+
+/**
+ * Watch the given file. Its path is reported by poll, exactly as it is given
+ * here, whenever the file is written.
+ */
+GLvoid FileWatcher::watch(const std::string& filepath)
+{
+#ifdef WATCHER_INOTIFY
+  size_t separator = filepath.find_last_of('/');
+  std::string directory = (separator == std::string::npos) ?
+                          "." : filepath.substr(0, separator);
+  GLint watch;
+
+  if (descriptor < 0 || filepath.empty()) {
+    return;
+  }
+
+  watch = inotify_add_watch(descriptor, directory.c_str(),
+                            IN_CLOSE_WRITE | IN_MOVED_TO);
+
+  if (watch < 0) {
+    fprintf(stderr, "\nFailed to watch directory: %s\n%s\n",
+            directory.c_str(), strerror(errno));
+    return;
+  }
+
+  directories[watch] = directory;
+  filepaths.push_back(filepath);
+#endif
+}
+
+/**
+ * Return the path of every watched file that was written since the last
+ * poll, once each, without blocking.
+ */
+std::vector<std::string> FileWatcher::poll()
+{
+  std::vector<std::string> changedFiles;
+
+#ifdef WATCHER_INOTIFY
+  GLchar buffer[WATCHER_BUFFER_SIZE]
+    __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+
+  if (descriptor < 0) {
+    return changedFiles;
+  }
+
+  while ((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+    for (GLchar* event = buffer; event < buffer + length;
+         event += sizeof(struct inotify_event) +
+                  ((struct inotify_event*)event)->len) {
+      const struct inotify_event* change = (struct inotify_event*)event;
+      std::string filepath;
+
+      if (!change->len || !directories.count(change->wd)) {
+        continue;
+      }
+
+      filepath = directories[change->wd] + '/' + change->name;
+
+      // Match the watched paths, which may not start with the directory.
+      for (GLuint i = 0; i < filepaths.size(); i++) {
+        const std::string& watched = filepaths[i];
+
+        if ((watched == filepath || "./" + watched == filepath) &&
+            std::find(changedFiles.begin(), changedFiles.end(), watched) ==
+            changedFiles.end()) {
+          changedFiles.push_back(watched);
+        }
+      }
+    }
+  }
+#endif
+
+  return changedFiles;
+}
@@ -0,0 +1,41 @@
+/**
+ * [Program description]
+ */
+
+#ifndef WATCHER_HEADER
+#define WATCHER_HEADER
+
+#include <map>
+#include <string>
+#include <vector>
+
+// inotify is only available on Linux, so elsewhere no changes are reported.
+#ifdef __linux__
+#define WATCHER_INOTIFY
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define WATCHER_BUFFER_SIZE 4096
+
+/**
+ * Reports when watched files are written. The directory of each file is
+ * watched rather than the file itself, because editors often save by writing
+ * a new file and renaming it over the old one.
+ */
+class FileWatcher
+{
+  public:
+    FileWatcher();
+    GLuint initialise();
+    GLvoid destroy();
+    GLvoid watch(const std::string& filepath);
+    std::vector<std::string> poll();
+
+  private:
+    GLint descriptor;
+    std::map<GLint, std::string> directories;
+    std::vector<std::string> filepaths;
+};
+
+#endif